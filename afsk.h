@@ -29,6 +29,8 @@ void afsk_ptt_on(void);
 void afsk_ptt_off(void);
 void afsk_txBitClock(void);
 void afsk_high_tone(bool t);
+uint32_t afsk_ptt_ticks(void);
+uint16_t afsk_ptt_count(void);
 
 
 /* Operations for AFSK demodulator/receiver */
@@ -37,6 +39,7 @@ void afsk_enable_decoder (void);
 void afsk_disable_decoder (void);
 bool afsk_channel_ready (uint16_t); /* ms, s, something else? */
 void afsk_check_channel ();
+bool afsk_channel_wait (void);
 
 
 /* Packet queues (outgoing, incoming) */
@@ -15,6 +15,7 @@
 #include "kernel/stream.h"
 #include "transceiver.h"
 #include "ui.h"
+#include "chanstat.h"
 
  
 /* The middle point between the two tones. */
@@ -45,6 +46,11 @@ double sqlevel;
 
 stream_t afsk_rx_stream;
 
+/* Channel state. Set when there is no signal on the channel (decoder 
+ * not running).
+ */
+static BCond chan_free;
+
 static void _afsk_stop_decoder (void);
 static void _afsk_start_decoder (void);
 static void _afsk_abort (void);
@@ -65,6 +71,7 @@ stream_t* afsk_init_decoder ()
     clear_bit(ACSR, ACD);
 #endif
     STREAM_INIT(afsk_rx_stream, AFSK_DECODER_BUFFER_SIZE);
+    bcond_init(&chan_free, true);
     return &afsk_rx_stream;
 }
 
@@ -77,6 +84,8 @@ stream_t* afsk_init_decoder ()
 static void _afsk_start_decoder ()
 {  
    decoder_running = true;
+   bcond_clear(&chan_free);
+   chanstat_carrier(true);
    valid_symbol = false;
    soft_symbol = hard_symbol = UNDECIDED;
     
@@ -114,6 +123,8 @@ static void _afsk_start_decoder ()
  
 static void _afsk_stop_decoder ()
 {  
+   if (decoder_running)
+      chanstat_carrier(false);
    decoder_running = false;
 #if defined TARGET_USBKEY
    clear_port(USBKEY_LED3); 
@@ -125,6 +136,7 @@ static void _afsk_stop_decoder ()
    pri_rgb_led_off();
    _afsk_abort (); // Just in case the decoder is disabled while the HDLC
                    // decoder is still in sync
+   bcond_set(&chan_free);
 }
 
 
@@ -185,12 +197,29 @@ void afsk_check_channel ()
        else if (decoder_running && (adf7021_read_rssi() <= sqlevel))
           _afsk_stop_decoder();   
 #endif    
+       chanstat_sample(decoder_running);
     }
     signal_ints = 0;
 }
 
 
 
+/***************************************************************************
+ * Wait until there is no signal on the channel. Return false (without 
+ * waiting) if the decoder is not enabled, i.e. if the channel is not 
+ * being monitored.  
+ ***************************************************************************/
+ 
+bool afsk_channel_wait()
+{
+    if (!decoder_enabled)
+       return false;
+    bcond_wait(&chan_free);
+    return true;
+}
+
+
+
 /******************************************************************************
  * Interrupt routine to be called when the input signal from the              *
  * receiver changes level (this corresponds to a zero-crossing of the input   *  
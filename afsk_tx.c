@@ -11,6 +11,7 @@
 #include "afsk.h"
 #include "kernel/kernel.h"
 #include "kernel/stream.h"
+#include "kernel/timer.h"
 #include "transceiver.h"
 #include "config.h"
 
@@ -29,6 +30,10 @@ static uint16_t timertop, start_tone;
 
 bool     transmit;     /* True when transmitter(modulator) is active. */        
 
+/* PTT time accounting */
+static uint32_t ptt_start, ptt_ticks;
+static uint16_t ptt_count;
+
    
 stream_t* afsk_init_encoder(void) 
 {
@@ -69,6 +74,8 @@ void afsk_ptt_on()
     
     set_port(LED2);
     transmit = true; 
+    ptt_start = timer_ticks();
+    ptt_count++;
 }
 
 
@@ -89,6 +96,37 @@ void afsk_ptt_off(void)
     adf7021_disable_tx();
     start_tone = _TXI_MARK;
     DAC_DDR &= ~DAC_MASK;
+    ptt_ticks += timer_ticks() - ptt_start;
+}
+
+
+
+/*******************************************************************************
+ * Total time (in timer ticks) and number of times the transmitter has 
+ * been turned on.
+ *******************************************************************************/
+
+uint32_t afsk_ptt_ticks()
+{
+    CONTAINS_CRITICAL;
+    uint32_t t;
+    enter_critical();
+    t = ptt_ticks;
+    if (transmit)
+       t += timer_ticks() - ptt_start;
+    leave_critical();
+    return t;
+}
+
+
+uint16_t afsk_ptt_count()
+{
+    CONTAINS_CRITICAL;
+    uint16_t n;
+    enter_critical();
+    n = ptt_count;
+    leave_critical();
+    return n;
 }
 
 
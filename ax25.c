@@ -4,6 +4,7 @@
 
 
 #include "ax25.h"
+#include "config.h"
 #include <string.h>
 #include <ctype.h>
 #include <stdio.h>
@@ -14,6 +15,11 @@
 static void encode_addr(FBUF *, char*, uint8_t, uint8_t);
 static uint8_t decode_addr(FBUF *, addr_t* );
 
+/* Cached header for own transmissions */
+static char own_hdr[AX25_HDR_LEN(7)];
+static uint8_t own_hdr_len = 0;
+static uint16_t own_hdr_gen;
+
 
    
 /*************************************************************************
@@ -86,6 +92,37 @@ void ax25_encode_header(FBUF* b, addr_t* from,
 
 
 
+/**********************************************************************
+ * Write header for own UI frames (from MYCALL to DEST via DIGIS).
+ * The encoded header is cached and copied into the buffer. It is 
+ * rebuilt only when parameters have been changed. 
+ **********************************************************************/
+
+void ax25_own_header(FBUF* b)
+{
+    if (own_hdr_len == 0 || own_hdr_gen != param_generation()) 
+    {
+        FBUF h;
+        addr_t from, to;
+        addr_t digis[7];
+        own_hdr_gen = param_generation();
+        GET_PARAM(MYCALL, &from);
+        GET_PARAM(DEST, &to);
+        GET_PARAM(DIGIS, &digis);
+        fbuf_new(&h);
+        ax25_encode_header(&h, &from, &to, digis, GET_BYTE_PARAM(NDIGIS), 
+                           FTYPE_UI, PID_NO_L3);
+        own_hdr_len = fbuf_length(&h);
+        fbuf_reset(&h);
+        fbuf_read(&h, own_hdr_len, own_hdr);
+        fbuf_release(&h);
+    }
+    fbuf_write(b, own_hdr, own_hdr_len);
+}
+
+
+
+
 /**********************************************************************
  * Decode an AX25 frame
  **********************************************************************/ 
@@ -111,6 +148,101 @@ uint8_t ax25_decode_header(FBUF* b, addr_t* from,
 
 
 
+/**********************************************************************
+ * Set up a header view of an AX25 frame. Only the SSID octets 
+ * are read. Return false if frame is too short or the address
+ * field is not terminated. 
+ **********************************************************************/
+
+bool ax25_hdr_view(ax25_hdr_t* h, FBUF* b)
+{
+    register uint8_t k;
+    h->fb = b;
+    for (k=0; k<AX25_MAX_ADDR; k++) {
+        if (fbuf_length(b) < (k+1)*7 + 2)
+           return false;
+        fbuf_rseek(b, k*7+6);
+        h->ssid[k] = fbuf_getChar(b);
+        if (k > 0 && (h->ssid[k] & FLAG_LAST))
+           break;
+    }
+    if (k == AX25_MAX_ADDR)
+        return false;
+    h->naddr = k+1;
+    h->hdrlen = AX25_HDR_LEN(k-1);
+    h->ctrl = fbuf_getChar(b);
+    h->pid = fbuf_getChar(b);
+    return true;
+}
+
+
+
+/**********************************************************************
+ * Return true if callsign of address k starts with prefix
+ * (case insensitive)
+ **********************************************************************/
+
+bool ax25_addr_prefix(ax25_hdr_t* h, uint8_t k, const char* prefix)
+{
+    register uint8_t i;
+    fbuf_rseek(h->fb, k*7);
+    for (i=0; i<6 && prefix[i] != 0; i++)
+        if (((uint8_t) fbuf_getChar(h->fb) >> 1) != toupper(prefix[i]))
+           return false;
+    return (prefix[i] == 0);
+}
+
+
+
+/**********************************************************************
+ * Return true if address k is equal to a (callsign and ssid)
+ **********************************************************************/
+
+bool ax25_addr_eq(ax25_hdr_t* h, uint8_t k, const addr_t* a)
+{
+    register uint8_t i;
+    register const char* c = a->callsign;
+    if (ax25_addr_ssid(h, k) != a->ssid)
+        return false;
+    fbuf_rseek(h->fb, k*7);
+    for (i=0; i<6; i++) {
+        if (((uint8_t) fbuf_getChar(h->fb) >> 1) != (*c ? toupper(*c) : ASCII_SPC))
+           return false;
+        if (*c) c++;
+    }
+    return true;
+}
+
+
+
+/**********************************************************************
+ * Copy address k into a
+ **********************************************************************/
+
+void ax25_addr_get(ax25_hdr_t* h, uint8_t k, addr_t* a)
+{
+    fbuf_rseek(h->fb, k*7);
+    decode_addr(h->fb, a);
+}
+
+
+
+/**********************************************************************
+ * Copy address k in encoded (shifted) form into a (7 octets)
+ **********************************************************************/
+
+void ax25_addr_raw(ax25_hdr_t* h, uint8_t k, uint8_t* a)
+{
+    register uint8_t i;
+    fbuf_rseek(h->fb, k*7);
+    for (i=0; i<7; i++)
+        a[i] = fbuf_getChar(h->fb);
+}
+
+
+
+
+
 /************************************************************************
  * Decode AX25 address field (callsign)
  ************************************************************************/      
@@ -169,26 +301,28 @@ void ax25_display_addr(Stream* out, addr_t* a)
 
 void ax25_display_frame(Stream* out, FBUF *b)
 {
-    fbuf_reset(b);
-    addr_t to, from;
-    addr_t digis[7];
-    uint8_t ctrl;
-    uint8_t pid;
-    uint8_t ndigis = ax25_decode_header(b, &from, &to, digis, &ctrl, &pid);
-    ax25_display_addr(out, &from); 
-    putstr_P(out, PSTR(">"));
-    ax25_display_addr(out, &to);
+    ax25_hdr_t hdr;
+    addr_t a;
     uint8_t i;
-    for (i=0; i<ndigis; i++) {
+    if (!ax25_hdr_view(&hdr, b))
+       return;
+    ax25_addr_get(&hdr, AX25_FROM, &a);
+    ax25_display_addr(out, &a); 
+    putstr_P(out, PSTR(">"));
+    ax25_addr_get(&hdr, AX25_TO, &a);
+    ax25_display_addr(out, &a);
+    for (i=0; i<ax25_hdr_ndigis(&hdr); i++) {
        putstr_P(out, PSTR(","));
-       ax25_display_addr(out, &digis[i]);
-       if (digis[i].flags & FLAG_DIGI)
+       ax25_addr_get(&hdr, AX25_DIGI(i), &a);
+       ax25_display_addr(out, &a);
+       if (ax25_addr_hbit(&hdr, AX25_DIGI(i)))
            putstr_P(out, PSTR("*"));
     }
-    if (ctrl == FTYPE_UI)
+    if (hdr.ctrl == FTYPE_UI)
     {
        putstr_P(out, PSTR(":"));    
-       for (i=0; i < fbuf_length(b) - AX25_HDR_LEN(ndigis); i++) {
+       fbuf_rseek(b, ax25_hdr_len(&hdr));
+       for (i=0; i < fbuf_length(b) - ax25_hdr_len(&hdr); i++) {
           register char c = fbuf_getChar(b); 
           if (c!='\n' && c!='\r' && c>=(char) 28)
               putch(out, c);
@@ -39,6 +39,35 @@ typedef struct {
 } addr_t;
 
 
+/* Header view. Address fields are indexed in place in the frame 
+ * buffer rather than copied. Only the SSID octets are cached.
+ * Address index 0 is destination, 1 is source and 2.. are digipeaters. 
+ */
+#define AX25_MAX_ADDR  9
+#define AX25_TO        0
+#define AX25_FROM      1
+#define AX25_DIGI(i)   ((i)+2)
+
+typedef struct {
+    FBUF* fb;
+    uint8_t naddr, hdrlen;
+    uint8_t ctrl, pid;
+    uint8_t ssid[AX25_MAX_ADDR];
+} ax25_hdr_t;
+
+bool ax25_hdr_view(ax25_hdr_t*, FBUF*);
+bool ax25_addr_prefix(ax25_hdr_t*, uint8_t, const char*);
+bool ax25_addr_eq(ax25_hdr_t*, uint8_t, const addr_t*);
+void ax25_addr_get(ax25_hdr_t*, uint8_t, addr_t*);
+void ax25_addr_raw(ax25_hdr_t*, uint8_t, uint8_t*);
+
+#define ax25_hdr_ndigis(h)   ((h)->naddr - 2)
+#define ax25_hdr_len(h)      ((h)->hdrlen)
+#define ax25_addr_ssid(h,k)  (((h)->ssid[k] & 0x1E) >> 1)
+#define ax25_addr_hbit(h,k)  (((h)->ssid[k] & FLAG_DIGI) != 0)
+#define ax25_addr_last(h,k)  (((h)->ssid[k] & FLAG_LAST) != 0)
+
+
 addr_t* addr(addr_t*, char*, uint8_t); 
 char* addr2str(char*, const addr_t*);
 void str2addr(addr_t* a, const char* str, bool d);
@@ -50,6 +79,10 @@ uint8_t ax25_decode_header(FBUF*, addr_t*, addr_t*, addr_t[],
                         uint8_t*, uint8_t*);
 
 
+/* Pre-encoded header for own transmissions (MYCALL>DEST,DIGIS) */
+void ax25_own_header(FBUF*);
+
+
 /* Display information about frame */
 void ax25_display_frame(Stream*, FBUF *);
 void ax25_display_addr(Stream*, addr_t*);
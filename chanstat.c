@@ -0,0 +1,216 @@
+/*
+ * Channel statistics. The channel state is sampled by the receiver
+ * (afsk_check_channel) CHANSTAT_RATE times per second while it is
+ * monitoring the channel. Each minute of monitoring, the busy
+ * percentage, the number of valid frames and the number of carrier
+ * events without a valid frame (collisions or noise) are stored in a
+ * ring of minute buckets. Every 10 minutes, these are summarised into
+ * a ring of 10-minute buckets. This gives rolling statistics for the
+ * last 1, 10 and 60 minutes.
+ *
+ * Sampling and carrier events are reported from interrupt handlers,
+ * frames from the HDLC decoder thread.
+ *
+ * Macros for configuration (defined in defines.h)
+ *    CHANSTAT_RATE - channel state samples per second.
+ */
+
+#include "defines.h"
+#include "kernel/kernel.h"
+#include "chanstat.h"
+#include <stdio.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#define SAMPLES_PER_MIN ((uint16_t) CHANSTAT_RATE * 60)
+
+typedef struct {
+    uint8_t busy;
+    uint16_t frames, bad;
+} bucket_t;
+
+static bucket_t min_hist[10], ten_hist[6];
+static uint8_t n_min, i_min, n_ten, i_ten;
+
+/* Current minute */
+static uint16_t samples, busy, frames, bad;
+
+/* Totals */
+static uint32_t t_minutes, t_carriers, t_bad, t_frames, t_bytes;
+
+/* A carrier event is counted as bad if no valid frame was decoded
+ * during it. Since the decoder may lag behind, this is decided when
+ * the next carrier starts.
+ */
+static bool got_frame, pending;
+
+
+
+/*************************************************************************
+ * Channel state sample (true if busy). Called from interrupt handler.
+ *************************************************************************/
+
+void chanstat_sample(bool b)
+{
+    uint8_t i;
+    if (b)
+       busy++;
+    if (++samples < SAMPLES_PER_MIN)
+       return;
+
+    /* End of minute */
+    min_hist[i_min].busy = (uint32_t) busy * 100 / samples;
+    min_hist[i_min].frames = frames;
+    min_hist[i_min].bad = bad;
+    i_min = (i_min + 1) % 10;
+    if (n_min < 10)
+       n_min++;
+    t_minutes++;
+    samples = busy = frames = bad = 0;
+
+    if (i_min == 0) {
+       /* End of 10 minute period */
+       bucket_t* t = &ten_hist[i_ten];
+       uint16_t b = 0;
+       t->frames = t->bad = 0;
+       for (i=0; i<10; i++) {
+          b += min_hist[i].busy;
+          t->frames += min_hist[i].frames;
+          t->bad += min_hist[i].bad;
+       }
+       t->busy = b / 10;
+       i_ten = (i_ten + 1) % 6;
+       if (n_ten < 6)
+          n_ten++;
+    }
+}
+
+
+
+/*************************************************************************
+ * Carrier detect on (true) or off. Called from interrupt handler.
+ *************************************************************************/
+
+void chanstat_carrier(bool on)
+{
+    if (on) {
+       if (pending) {
+          bad++;
+          t_bad++;
+       }
+       pending = got_frame = false;
+       t_carriers++;
+    }
+    else
+       pending = !got_frame;
+}
+
+
+
+/*************************************************************************
+ * Valid frame of given length (bytes) received.
+ *************************************************************************/
+
+void chanstat_frame(uint16_t len)
+{
+    CONTAINS_CRITICAL;
+    enter_critical();
+    got_frame = true;
+    pending = false;
+    frames++;
+    t_frames++;
+    t_bytes += len;
+    leave_critical();
+}
+
+
+
+/*************************************************************************
+ * Get statistics for the last 1, 10 or 60 minutes. If less time has
+ * been monitored, the available (or current) minutes are used.
+ *************************************************************************/
+
+void chanstat_get(uint8_t window, chanstat_t* st)
+{
+    CONTAINS_CRITICAL;
+    bucket_t* h = min_hist;
+    uint8_t n, i;
+    uint16_t b = 0;
+    uint32_t f = 0;
+
+    enter_critical();
+    n = n_min;
+    st->bad = 0;
+    if (window >= 60 && n_ten > 0) {
+       h = ten_hist;
+       n = n_ten;
+    }
+    else if (window <= 1 && n > 0) {
+       h = &min_hist[(i_min + 9) % 10];
+       n = 1;
+    }
+    if (n == 0) {
+       /* Less than a minute monitored: Scale to a minute */
+       if (samples > 0) {
+          st->busy = (uint32_t) busy * 100 / samples;
+          f = (uint32_t) frames * 10 * SAMPLES_PER_MIN / samples;
+       }
+       else
+          st->busy = 0;
+       st->frames = (f > 0xffff ? 0xffff : f);
+       st->bad = bad;
+    }
+    else {
+       for (i=0; i<n; i++) {
+          b += h[i].busy;
+          f += h[i].frames;
+          st->bad += h[i].bad;
+       }
+       st->busy = b / n;
+       st->frames = f * 10 / (h == ten_hist ? n * 10 : n);
+    }
+    leave_critical();
+}
+
+
+uint8_t chanstat_busy(uint8_t window)
+{
+    chanstat_t st;
+    chanstat_get(window, &st);
+    return st.busy;
+}
+
+
+
+void chanstat_show(Stream* out)
+{
+    CONTAINS_CRITICAL;
+    static const uint8_t win[3] PROGMEM = {1, 10, 60};
+    char buf[64];
+    chanstat_t st;
+    uint8_t i;
+    uint32_t minutes, carriers, nbad, nframes, bytes;
+
+    enter_critical();
+    minutes = t_minutes;
+    carriers = t_carriers;
+    nbad = t_bad;
+    nframes = t_frames;
+    bytes = t_bytes;
+    leave_critical();
+
+    putstr_P(out, PSTR("Window   Busy   Frames/min   No frame\r\n"));
+    for (i=0; i<3; i++) {
+       chanstat_get(pgm_read_byte(&win[i]), &st);
+       sprintf_P(buf, PSTR("%2u min   %3u%%   %4u.%u       %u\r\n"), pgm_read_byte(&win[i]),
+          st.busy, st.frames / 10, st.frames % 10, st.bad);
+       putstr(out, buf);
+    }
+    sprintf_P(buf, PSTR("Monitored: %lu min, carrier events: %lu, no frame: %lu\r\n"),
+       minutes, carriers, nbad);
+    putstr(out, buf);
+    sprintf_P(buf, PSTR("Frames: %lu, mean length: %lu bytes\r\n"),
+       nframes, (nframes > 0 ? bytes / nframes : 0));
+    putstr(out, buf);
+}
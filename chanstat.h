@@ -0,0 +1,22 @@
+#if !defined __CHANSTAT_H__
+#define __CHANSTAT_H__
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include "kernel/stream.h"
+
+/* Channel statistics for a window of 1, 10 or 60 minutes */
+typedef struct {
+    uint8_t busy;          /* Percent of time with signal on channel */
+    uint16_t frames;       /* Valid frames per minute (x10) */
+    uint16_t bad;          /* Carrier events without a valid frame */
+} chanstat_t;
+
+void    chanstat_sample(bool);
+void    chanstat_carrier(bool);
+void    chanstat_frame(uint16_t);
+void    chanstat_get(uint8_t, chanstat_t*);
+uint8_t chanstat_busy(uint8_t);
+void    chanstat_show(Stream*);
+
+#endif /* __CHANSTAT_H__ */
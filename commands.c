@@ -11,6 +11,10 @@
 #include "fbuf.h"
 #include "ax25.h"
 #include "config.h"
+#include "journal.h"
+#include "tracklog.h"
+#include "chanstat.h"
+#include "digipeater.h"
 #include "transceiver.h"
 #include "radio.h"
 #include "gps.h"
@@ -47,6 +51,7 @@ static void do_power     (uint8_t, char**, Stream*, Stream*);
 static void do_squelch   (uint8_t, char**, Stream*, Stream*);
 static void do_rssi      (uint8_t, char**, Stream*, Stream*);
 static void do_digipath  (uint8_t, char**, Stream*, Stream*);
+static void do_digialias (uint8_t, char**, Stream*, Stream*);
 static void do_trace     (uint8_t, char**, Stream*, Stream*);
 static void do_txtone    (uint8_t, char**, Stream*, Stream*);
 static void do_vbatt     (uint8_t, char**, Stream*, Stream*);
@@ -56,9 +61,17 @@ static void do_btext     (uint8_t, char**, Stream*, Stream*);
 static void do_ps        (uint8_t, char**, Stream*, Stream*);
 static void do_reset     (uint8_t, char**, Stream*, Stream*);
 static void do_digipeater(uint8_t, char**, Stream*, Stream*);
+static void do_kiss      (uint8_t, char**, Stream*, Stream*);
+static void do_config    (uint8_t, char**, Stream*, Stream*);
+static void do_usbtest   (uint8_t, char**, Stream*, Stream*);
+static void do_tracklog  (uint8_t, char**, Stream*, Stream*);
+static void do_airtime   (uint8_t, char**, Stream*, Stream*);
+static void do_channel   (uint8_t, char**, Stream*, Stream*);
 
 static char buf[BUFSIZE]; 
 extern fbq_t* outframes;  
+extern Stream cdc_data_instr; 
+extern Stream cdc_data_outstr;
 
 /* May be moved to tracker.h ??*/
 extern void tracker_on(void);
@@ -83,7 +96,7 @@ static void _parameter_setting_uint16(uint8_t argc, char** argv, Stream* out,
        putstr_P(out, helptext);
     else if (argc > 1) {
        if (sscanf_P(argv[1], sfmt, &x) != 1 || x<lower || x>upper) {
-          sprintf_P(buf, PSTR("ERROR: parameter must be a number in range %d-%d\r\n"),lower,upper);
+          sprintf_P(buf, PSTR("ERROR: parameter must be a number in range %u-%u\r\n"),lower,upper);
           putstr(out,buf); 
        }
        else {
@@ -243,12 +256,15 @@ void cmdProcessor(Stream *in, Stream *out)
          {
              if (argc < 2) {
                 putstr_P(out, PSTR("Available commands: \r\n"));
-                putstr_P(out, PSTR("  afc, altitude, autopower, beep, boot, bootsound, btext, compress, converse,\r\n")); 
-                putstr_P(out, PSTR("  dest, digipeater, digi-sar, digi-wide1, fcal, extraturn, fakereports, \r\n")); 
-                putstr_P(out, PSTR("  freq, gps, listen,  maxframe, maxpause, maxturn, mindist, minpause, \r\n"));
-                putstr_P(out, PSTR("  mycall, oident, osymbol,  path, powersave,  repeat, reset, rssi, squelch, \r\n"));
-                putstr_P(out, PSTR("  statustime, symbol, testpacket, timestamp, teston, tracker, tracktime, \r\n"));
-                putstr_P(out, PSTR("  txdelay, txon, txmon, txtail, txtone, version\r\n"));
+                putstr_P(out, PSTR("  afc, airtime, altitude, autopower, beep, boot, bootsound, btext, channel, compress, \r\n"));
+                putstr_P(out, PSTR("  config, converse, csma, dest, digipeater, digi-alias, digi-maxduty, digi-maxhops, \r\n"));
+                putstr_P(out, PSTR("  digi-preempt, digi-ratelimit, digi-ratetime, digi-sar, digi-viscous, digi-wide1, \r\n"));
+                putstr_P(out, PSTR("  digi-widen, fcal, extraturn, \r\n"));
+                putstr_P(out, PSTR("  fakereports, freq, gps, kiss, listen,  maxframe, maxpause, maxturn, mice, mindist, minpause, \r\n"));
+                putstr_P(out, PSTR("  mycall, oident, osymbol,  path, persistence, powersave,  repeat, reset, rssi, \r\n"));
+                putstr_P(out, PSTR("  slottime, squelch, standby, statustime, symbol, telemetry, testpacket, timestamp, \r\n"));
+                putstr_P(out, PSTR("  teston, tracker, tracklog, tracktime, txdelay, txon, txmon, txtail, txtone, ubx, \r\n"));
+                putstr_P(out, PSTR("  ubxbaud, version\r\n"));
                 putstr_P(out, PSTR("\r\nMore info: \r\n  help <command> or ? <command>\r\n\r\n"));
                 continue;
              }
@@ -268,7 +284,7 @@ void cmdProcessor(Stream *in, Stream *out)
          else IF_COMMAND(arg, "testpacket", 5, do_testpacket, argc, argv, out, in, 
               help, PSTR("Send test packet\r\n"));                               
          else IF_COMMAND(arg, "gps", 2, do_nmea, argc, argv, out, in, 
-              help, PSTR("GPS ON|OFF|NMEA|POS:\r\n  GPS ON/OFF - turn on or off GPS (should only be used when TRACKER is OFF)\r\n  GPS NMEA - show nmea stream\r\n  GPS POS - show valid positions\r\n"));     
+              help, PSTR("GPS ON|OFF|NMEA|POS|STATS:\r\n  GPS ON/OFF - turn on or off GPS (should only be used when TRACKER is OFF)\r\n  GPS NMEA - show nmea stream\r\n  GPS POS - show valid positions\r\n  GPS STATS - show time to fix and energy statistics\r\n"));     
          else IF_COMMAND(arg, "tracker", 6, do_tracker, argc, argv, out, in,
               help, PSTR("Turn on or off automatic tracking\r\n"));
          else IF_COMMAND(arg, "digipeater", 4, do_digipeater, argc, argv, out, in,
@@ -283,12 +299,24 @@ void cmdProcessor(Stream *in, Stream *out)
               help, PSTR("Process status. Show info about tasks (for developers)\r\n"));    
          else IF_COMMAND(arg, "vbatt", 2, do_vbatt, argc, argv, out, in,
               help, PSTR("Show battery voltage\r\n"));
+         else IF_COMMAND(arg, "airtime", 3, do_airtime, argc, argv, out, in,
+              help, PSTR("Show transmitter airtime and energy statistics. TX charge, also in telemetry, is from a fixed current estimate and does not follow TXPOWER\r\n"));
+         else IF_COMMAND(arg, "channel", 4, do_channel, argc, argv, out, in,
+              help, PSTR("Show channel statistics: busy time, frames and carrier events without valid frame\r\n"));
          else IF_COMMAND(arg, "listen", 3, do_listen, argc, argv, out, in, 
               help, PSTR("Enter listen mode. Show incoming packets on console (CTRL-C to leave)\r\n"));            
          else if (strcasecmp("k", arg) == 0 || _cmpCmd("converse", arg, 4))
              _do_command( do_converse, help, 
                 PSTR("Enter converse mode. Show incoming packets. Send typed text as packets (CTRL-C to leave\r\n"), 
                 argc, argv, out, in );   
+         else IF_COMMAND(arg, "kiss", 4, do_kiss, argc, argv, out, in,
+              help, PSTR("KISS ON|OFF: KISS TNC mode on the USB data channel (second serial port)\r\n"));
+         else IF_COMMAND(arg, "config", 4, do_config, argc, argv, out, in,
+              help, PSTR("CONFIG DUMP|LOAD: Write or read all settings as a binary image on the USB data channel\r\n"));
+         else IF_COMMAND(arg, "usbtest", 4, do_usbtest, argc, argv, out, in,
+              help, PSTR("USBTEST <KB>: Send data on the USB data channel and show the rate. Read it on the host meanwhile\r\n"));
+         else IF_COMMAND(arg, "tracklog", 6, do_tracklog, argc, argv, out, in,
+              help, PSTR("TRACKLOG ON|OFF|DUMP|CLEAR: Log positions in EEPROM. Dump log as CSV\r\n"));
          else IF_COMMAND(arg, "reset", 5, do_reset, argc, argv, out, in,
                help, PSTR("Reset all settings to defaults\r\n"));      
 	      else if (strcasecmp("protocol", arg) == 0) 
@@ -303,6 +331,8 @@ void cmdProcessor(Stream *in, Stream *out)
               help, PSTR("Destination address\r\n"));  
          else IF_COMMAND(arg, "path", 3, do_digipath, argc, argv, out, in,
               help, PSTR("Digipeater path\r\n"));
+         else IF_COMMAND(arg, "digi-alias", 6, do_digialias, argc, argv, out, in,
+              help, PSTR("Digipeater. Aliases to digipeat on, in addition to MYCALL (up to 7, OFF to clear)\r\n"));
          else IF_COMMAND(arg, "symbol", 3, do_symbol, argc, argv, out, in,
               help, PSTR("Symbol for position reports. <symtable> <symbol>\r\n"));  
          else IF_COMMAND(arg, "osymbol", 4, do_obj_symbol, argc, argv, out, in,
@@ -330,6 +360,17 @@ void cmdProcessor(Stream *in, Stream *out)
                   ( arg, "maxframe", 5, argc, argv, out,
                     MAXFRAME, 1, 7, PSTR("MAXFRAME %d\r\n\0"), PSTR(" %d"),
                     help, PSTR("Max number of frames to send in the same transmission (range 1-7) \r\n") );
+         else IF_COMMAND_PARAM_uint8
+                  ( arg, "persistence", 4, argc, argv, out,
+                    PERSISTENCE, 0, 255, PSTR("PERSISTENCE %d\r\n\0"), PSTR(" %d"),
+                    help, PSTR("Probability (in 1/256 units) of transmitting when channel is free (range 0-255)\r\n") );
+         else IF_COMMAND_PARAM_uint8
+                  ( arg, "slottime", 4, argc, argv, out,
+                    SLOTTIME, 1, 255, PSTR("SLOTTIME %d\r\n\0"), PSTR(" %d"),
+                    help, PSTR("Time (in 10 ms units) to wait before trying again to access channel (range 1-255)\r\n") );
+         else IF_COMMAND_PARAM_bool
+                 ( arg, "csma", 4, argc, argv, out, CSMA_ADAPTIVE, PSTR("CSMA"),
+                   help, PSTR("Adapt persistence and slottime to measured channel load (on/off)\r\n") );
          else IF_COMMAND_PARAM_uint16
                  ( arg, "afc", 3, argc, argv, out, 
                     TRX_AFC, 0, 12000, PSTR("AFC %d\r\n\0"), PSTR(" %d"),
@@ -346,6 +387,10 @@ void cmdProcessor(Stream *in, Stream *out)
                  (  arg, "gpsbaud", 4, argc, argv, out, 
                     GPS_BAUD, 1200, 19200, PSTR("GPSBAUD %d\r\n\0"), PSTR(" %d"),
                     help, PSTR("Baud rate for serial comm with GPS unit\r\n") );
+         else IF_COMMAND_PARAM_uint16 
+                 (  arg, "ubxbaud", 4, argc, argv, out, 
+                    GPS_UBX_BAUD, 4800, 38400, PSTR("UBXBAUD %u\r\n\0"), PSTR(" %u"),
+                    help, PSTR("Baud rate for serial comm with GPS unit in UBX mode\r\n") );
          else IF_COMMAND_PARAM_uint16 
                  ( arg, "maxturn", 5, argc, argv, out, 
                     TRACKER_TURN_LIMIT, 0, 180, PSTR("MAXTURN %d\r\n\0"), PSTR(" %d"), 
@@ -375,9 +420,21 @@ void cmdProcessor(Stream *in, Stream *out)
          else IF_COMMAND_PARAM_bool
                  ( arg, "compress", 4, argc, argv, out, COMPRESS_ON, PSTR("COMPRESS"),
                    help, PSTR("Compress position reports (on/off)\r\n") );
+         else IF_COMMAND_PARAM_bool
+                 ( arg, "mice", 4, argc, argv, out, MICE_ON, PSTR("MICE"),
+                   help, PSTR("Use Mic-E encoding for own position reports (on/off)\r\n") );
+         else IF_COMMAND_PARAM_bool
+                 ( arg, "telemetry", 4, argc, argv, out, TELEMETRY_ON, PSTR("TELEMETRY"),
+                   help, PSTR("Send airtime statistics as telemetry with status reports (on/off)\r\n") );
          else IF_COMMAND_PARAM_bool
                  ( arg, "powersave", 6, argc, argv, out, GPS_POWERSAVE, PSTR("POWERSAVE"),
                    help, PSTR("Try to save power by turning off GPS when not moving (on/off)\r\n") );  
+         else IF_COMMAND_PARAM_bool
+                 ( arg, "standby", 5, argc, argv, out, GPS_STANDBY, PSTR("STANDBY"),
+                   help, PSTR("In powersave mode, put GPS in standby using serial link instead of turning it off. Takes effect after reboot (on/off)\r\n") );  
+         else IF_COMMAND_PARAM_bool
+                 ( arg, "ubx", 3, argc, argv, out, GPS_UBX, PSTR("UBX"),
+                   help, PSTR("Use u-blox binary protocol (NAV-PVT) with GPS unit. Takes effect after reboot (on/off)\r\n") );  
          else IF_COMMAND_PARAM_bool
                  ( arg, "beep", 2, argc, argv, out, REPORT_BEEP, PSTR("BEEP"),
                    help, PSTR("Beep when sending position reports automatically (on/off)\r\n") );        
@@ -401,7 +458,33 @@ void cmdProcessor(Stream *in, Stream *out)
                    help, PSTR("Digipeater. Preemption on SAR alias\r\n") );
          else IF_COMMAND_PARAM_bool
            ( arg, "digi-wide1", 6, argc, argv, out, DIGIPEATER_WIDE1, PSTR("DIGI-WIDE1"),
-                   help, PSTR("Digipeater. Preemption on SAR alias\r\n") );        
+                   help, PSTR("Digipeater. Fill-in mode: digipeat on WIDE1-1 (on/off)\r\n") );        
+         else IF_COMMAND_PARAM_bool
+           ( arg, "digi-widen", 10, argc, argv, out, DIGIPEATER_WIDEN, PSTR("DIGI-WIDEN"),
+                   help, PSTR("Digipeater. Digipeat on WIDEn-N and TRACEn-N, for hilltop digipeaters (on/off)\r\n") );
+         else IF_COMMAND_PARAM_bool
+           ( arg, "digi-preempt", 6, argc, argv, out, DIGIPEATER_PREEMPT, PSTR("DIGI-PREEMPT"),
+                   help, PSTR("Digipeater. Preemption on MYCALL or alias anywhere in path (on/off)\r\n") );
+         else IF_COMMAND_PARAM_uint8
+                  ( arg, "digi-maxhops", 6, argc, argv, out,
+                    DIGI_MAXHOPS, 1, 7, PSTR("DIGI-MAXHOPS %d\r\n\0"), PSTR(" %d"),
+                    help, PSTR("Digipeater. Don't digipeat WIDEn-N or TRACEn-N with larger n (range 1-7)\r\n") );
+         else IF_COMMAND_PARAM_uint8
+                  ( arg, "digi-viscous", 6, argc, argv, out,
+                    DIGI_VISCOUS, 0, 20, PSTR("DIGI-VISCOUS %d\r\n\0"), PSTR(" %d"),
+                    help, PSTR("Digipeater. Seconds to wait before sending. Don't send if another digipeater is heard sending it first (range 0-20, 0=off)\r\n") );
+         else IF_COMMAND_PARAM_uint8
+                  ( arg, "digi-ratelimit", 10, argc, argv, out,
+                    DIGI_RATE_N, 0, 50, PSTR("DIGI-RATELIMIT %d\r\n\0"), PSTR(" %d"),
+                    help, PSTR("Digipeater. Max number of frames from each source per DIGI-RATETIME (range 0-50, 0=off)\r\n") );
+         else IF_COMMAND_PARAM_uint8
+                  ( arg, "digi-ratetime", 10, argc, argv, out,
+                    DIGI_RATE_WINDOW, 1, 60, PSTR("DIGI-RATETIME %d\r\n\0"), PSTR(" %d"),
+                    help, PSTR("Digipeater. Time window (in minutes) for rate limit (range 1-60)\r\n") );
+         else IF_COMMAND_PARAM_uint8
+                  ( arg, "digi-maxduty", 6, argc, argv, out,
+                    DIGI_MAXDUTY, 0, 100, PSTR("DIGI-MAXDUTY %d\r\n\0"), PSTR(" %d"),
+                    help, PSTR("Digipeater. Don't digipeat if transmitter duty cycle (percent) is at or above this (range 0-100, 0=off)\r\n") );
          else IF_COMMAND_PARAM_bool
                  ( arg, "fakereports", 6, argc, argv, out, FAKE_REPORTS, PSTR("FAKEREPORTS"),
                    help, PSTR("EXPERIMENTAL: In LISTEN or CONVERSE mode, display position reports every TRACKTIME (on/off)\r\n") ); 	     
@@ -423,6 +506,9 @@ typedef void (*AppPtr_t)(void) ATTR_NO_RETURN;
 
 static void do_boot(uint8_t argc, char** argv, Stream* out, Stream* in)
 {
+  /* Settings not yet written back to EEPROM would be lost */
+  param_flush ();
+  
   /* Turn off external devices */
   USB_ShutDown ();
   gps_off ();
@@ -452,6 +538,115 @@ static void do_reset(uint8_t argc, char** argv, Stream* out, Stream* in)
    putstr_P(out, PSTR("Ok (reset settings)\r\n"));
 }
 
+/************************************************
+ * Dump or load all settings as a binary image
+ * on the USB data channel
+ ************************************************/
+ 
+static void do_config(uint8_t argc, char** argv, Stream* out, Stream* in)
+{
+   if (argc < 2) {
+      putstr_P(out, PSTR("ERROR: parameter must be 'DUMP' or 'LOAD'\r\n"));
+      return;
+   }
+   if (kiss_is_on()) {
+      putstr_P(out, PSTR("ERROR: data channel is in use (KISS mode)\r\n"));
+      return;
+   }
+   if (strncasecmp("dump", argv[1], 2) == 0) {
+      config_dump(&cdc_data_outstr);
+      putstr_P(out, PSTR("Ok (settings written to data channel)\r\n"));
+   }
+   else if (strncasecmp("load", argv[1], 2) == 0) {
+      putstr_P(out, PSTR("Waiting for image on data channel..\r\n"));
+      uint8_t err = config_load(&cdc_data_instr);
+      if (err == 0)
+         putstr_P(out, PSTR("Ok (settings loaded)\r\n"));
+      else if (err == 1)
+         putstr_P(out, PSTR("ERROR: bad image header\r\n"));
+      else if (err == 2)
+         putstr_P(out, PSTR("ERROR: CRC check failed. Nothing changed\r\n"));
+      else
+         putstr_P(out, PSTR("ERROR: timeout. Nothing changed\r\n"));
+   }
+   else 
+      putstr_P(out, PSTR("ERROR: parameter must be 'DUMP' or 'LOAD'\r\n"));
+}
+
+
+
+/************************************************
+ * USB throughput test. Send a number of KB in
+ * 64 byte lines on the data channel, and show
+ * the rate. The host must read the data channel
+ * meanwhile, e.g. cat /dev/ttyACM1 > /dev/null
+ ************************************************/
+
+static void do_usbtest(uint8_t argc, char** argv, Stream* out, Stream* in)
+{
+   int n = 64;
+   uint16_t i;
+   uint8_t j;
+   uint32_t t;
+   
+   if (argc > 1 && (sscanf(argv[1], " %d", &n) != 1 || n < 1 || n > 1000)) {
+      putstr_P(out, PSTR("ERROR: parameter must be a number in range 1-1000\r\n"));
+      return;
+   }
+   if (kiss_is_on()) {
+      putstr_P(out, PSTR("ERROR: data channel is in use (KISS mode)\r\n"));
+      return;
+   }
+   putstr_P(out, PSTR("Sending on data channel..\r\n"));
+   t = timer_ticks();
+   for (i=0; i < n * 16; i++) {
+      for (j=0; j<63; j++)
+         putch(&cdc_data_outstr, 'A' + j % 26);
+      putch(&cdc_data_outstr, '\n');
+   }
+   t = timer_ticks() - t;
+   if (t == 0)
+      t = 1;
+   sprintf_P(buf, PSTR("%d KB in %lu ms: %lu bytes/sec\r\n"), 
+      n, t * 1000 / TIMER_RESOLUTION, (uint32_t) n * 1024 * TIMER_RESOLUTION / t);
+   putstr(out, buf);
+}
+
+
+
+/************************************************
+ * Track log control and download
+ ************************************************/
+
+static void do_tracklog(uint8_t argc, char** argv, Stream* out, Stream* in)
+{
+   if (argc < 2) {
+      if (GET_BYTE_PARAM(TRACKLOG_ON))
+         putstr_P(out, PSTR("TRACKLOG ON\r\n"));
+      else
+         putstr_P(out, PSTR("TRACKLOG OFF\r\n"));
+      return;
+   }
+   if (strncasecmp("on", argv[1], 2) == 0) {
+      SET_BYTE_PARAM(TRACKLOG_ON, 1);
+      putstr_P(out, PSTR("Ok\r\n"));
+   }
+   else if (strncasecmp("off", argv[1], 2) == 0) {
+      SET_BYTE_PARAM(TRACKLOG_ON, 0);
+      putstr_P(out, PSTR("Ok\r\n"));
+   }
+   else if (strncasecmp("dump", argv[1], 2) == 0)
+      tracklog_dump(out);
+   else if (strncasecmp("clear", argv[1], 2) == 0) {
+      tracklog_clear();
+      putstr_P(out, PSTR("Ok\r\n"));
+   }
+   else
+      putstr_P(out, PSTR("ERROR: parameter must be 'ON', 'OFF', 'DUMP' or 'CLEAR'\r\n"));
+}
+
+
+
 /************************************************
  * Report firmware version
  ************************************************/
@@ -503,6 +698,20 @@ static void do_vbatt(uint8_t argc, char** argv, Stream* out, Stream* in)
 
 
 
+static void do_airtime(uint8_t argc, char** argv, Stream* out, Stream* in)
+{
+   hdlc_show_txstat(out);
+}
+
+
+
+static void do_channel(uint8_t argc, char** argv, Stream* out, Stream* in)
+{
+   chanstat_show(out);
+}
+
+
+
 /************************************************
  * Decode and show incoming packets
  ************************************************/
@@ -534,13 +743,7 @@ static void do_converse(uint8_t argc, char** argv, Stream* out, Stream* in)
    mon_activate(true); 
    while ( readLine(in, out, buf, BUFSIZE)) { 
         fbuf_new(&packet);
-        addr_t from, to; 
-        GET_PARAM(MYCALL, &from);
-        GET_PARAM(DEST, &to);       
-        addr_t digis[7];
-        uint8_t ndigis = GET_BYTE_PARAM(NDIGIS); 
-        GET_PARAM(DIGIS, &digis);   
-        ax25_encode_header(&packet, &from, &to, digis, ndigis, FTYPE_UI, PID_NO_L3);
+        ax25_own_header(&packet);
         fbuf_putstr(&packet, buf);                        
         fbq_put(outframes, packet);
    }
@@ -552,6 +755,36 @@ static void do_converse(uint8_t argc, char** argv, Stream* out, Stream* in)
 
 
 
+/************************************************
+ * KISS TNC mode
+ ************************************************/
+
+static void do_kiss(uint8_t argc, char** argv, Stream* out, Stream* in)
+{
+  if (argc < 2)
+  {
+    if (kiss_is_on())
+      putstr_P(out, PSTR("KISS ON\r\n"));
+    else
+      putstr_P(out, PSTR("KISS OFF\r\n"));
+    return;
+  }
+  if (strncasecmp("on", argv[1], 2) == 0) {   
+    putstr_P(out, PSTR("Ok\r\n"));
+    kiss_activate(true);
+  }  
+  else if (strncasecmp("off", argv[1], 2) == 0) {     
+    putstr_P(out, PSTR("Ok\r\n"));
+    kiss_activate(false);
+  }
+  else {
+    putstr_P(out, PSTR("ERROR: parameter must be 'ON' or 'OFF'\r\n"));
+  }
+}
+
+
+
+
 /*********************************************
  * tx : Send AX25 test packet
  *********************************************/
@@ -559,15 +792,9 @@ static void do_converse(uint8_t argc, char** argv, Stream* out, Stream* in)
 static void do_testpacket(uint8_t argc, char** argv, Stream* out, Stream* in)
 { 
   FBUF packet;    
-  addr_t from, to; 
   radio_require();
-  GET_PARAM(MYCALL, &from);
-  GET_PARAM(DEST, &to);       
-  addr_t digis[7];
-  uint8_t ndigis = GET_BYTE_PARAM(NDIGIS); 
-  GET_PARAM(DIGIS, &digis);   
   fbuf_new(&packet);
-  ax25_encode_header(&packet, &from, &to, digis, ndigis, FTYPE_UI, PID_NO_L3);
+  ax25_own_header(&packet);
   fbuf_putstr_P(&packet, PSTR("The lazy brown dog jumps over the quick fox 1234567890"));                      
   putstr_P(out, PSTR("Sending (AX25 UI) test packet....\r\n"));       
   fbq_put(outframes, packet);
@@ -580,20 +807,21 @@ static void do_digipeater(uint8_t argc, char** argv, Stream* out, Stream* in)
 {
   if (argc < 2)
   {
-    if (GET_BYTE_PARAM(DIGIPEATER_ON))
+    if (GET_STATE(DIGIPEATER_ON))
       putstr_P(out, PSTR("DIGIPEATER ON\r\n"));
     else
       putstr_P(out, PSTR("DIGIPEATER OFF\r\n"));
+    digipeater_show(out);
     return;
   }
   if (strncasecmp("on", argv[1], 2) == 0) {   
     putstr_P(out, PSTR("Ok\r\n"));
-    SET_BYTE_PARAM(DIGIPEATER_ON, true);
+    SET_STATE(DIGIPEATER_ON, true);
     digipeater_activate(true);
   }  
   else if (strncasecmp("off", argv[1], 2) == 0) {     
     putstr_P(out, PSTR("Ok\r\n"));
-    SET_BYTE_PARAM(DIGIPEATER_ON, false);
+    SET_STATE(DIGIPEATER_ON, false);
     digipeater_activate(false);
   }
   else {
@@ -613,7 +841,7 @@ Semaphore nmea_run;
 static void do_nmea(uint8_t argc, char** argv, Stream* out, Stream* in)
 {                                                                                                            
   if (argc < 2) {
-      putstr_P(out, PSTR("Usage: GPS on|off|nmea|pos\r\n"));
+      putstr_P(out, PSTR("Usage: GPS on|off|nmea|pos|stats\r\n"));
       return;
   }
   else if (strncasecmp("on", argv[1], 2) == 0) {
@@ -630,6 +858,10 @@ static void do_nmea(uint8_t argc, char** argv, Stream* out, Stream* in)
       putstr_P(out, PSTR("***** NMEA PACKETS *****\r\n"));
       gps_mon_raw();
   } 
+  else if (strncasecmp("stats", argv[1], 2) == 0) {
+      gps_stats(out);
+      return;
+  }
   else if (strncasecmp("pos", argv[1], 3) == 0){
       putstr_P(out, PSTR("***** VALID POSITION REPORTS (GPRMC) *****\r\n"));
       gps_mon_pos();
@@ -653,7 +885,7 @@ static void do_tracker(uint8_t argc, char** argv, Stream* out, Stream* in)
 {
   if (argc < 2)
   {
-      if (GET_BYTE_PARAM(TRACKER_ON))
+      if (GET_STATE(TRACKER_ON))
           putstr_P(out, PSTR("TRACKER ON\r\n"));
       else
           putstr_P(out, PSTR("TRACKER OFF\r\n"));
@@ -854,6 +1086,49 @@ static void do_digipath(uint8_t argc, char** argv, Stream* out, Stream* in)
 }
 
 
+/*********************************************
+ * config: digipeater aliases
+ *********************************************/
+ 
+static void do_digialias(uint8_t argc, char** argv, Stream* out, Stream* in)
+{
+    __digilist_t aliases;
+    uint8_t n;
+    uint8_t i;
+    char cbuf[11]; 
+    
+    if (argc > 1) {
+       if (argc==2 && strncasecmp("off", argv[1], 3)==0)
+           n = 0;
+       else{
+         n = argc - 1;
+         if (n > 7) 
+             n = 7;
+         for (i=0; i<n; i++)
+             str2addr(&aliases[i], argv[i+1], false);
+         SET_PARAM(DIGI_ALIASES, aliases);     
+       }
+       SET_BYTE_PARAM(NDIGI_ALIASES, n);
+       putstr_P(out,PSTR("Ok\r\n"));
+    }
+    else  {
+       n = GET_BYTE_PARAM(NDIGI_ALIASES);
+       GET_PARAM(DIGI_ALIASES, &aliases);
+       putstr_P(out, PSTR("DIGI-ALIAS ")); 
+       if (n==0)
+           putstr_P(out, PSTR("<EMPTY>\r\n"));
+       for (i=0; i<n; i++)
+       {   
+           putstr(out, addr2str(cbuf, &aliases[i]));           
+           if (i < n-1)
+               putstr_P(out, PSTR(", ")); 
+       }
+       putstr_P(out,PSTR("\n\r"));
+    }
+}
+
+
+
 /***********************************************
  * config: Beacon text (comment in pos reports)
  ***********************************************/
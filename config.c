@@ -7,7 +7,373 @@
 
 #define __CONFIG_C__   /* IMPORTANT */
 #include "config.h"
+#include "defines.h"
+#include "kernel/kernel.h"
+#include "kernel/timer.h"
 #include <stdio.h>
+#include <util/crc16.h>
+
+/* Incremented each time a parameter is written. Lets other modules 
+ * keep cached values derived from parameters. 16 bit, so that it does
+ * not wrap around to a value a cache has seen in practice. 
+ */
+static uint16_t param_gen = 0;
+
+uint16_t param_generation()
+   { return param_gen; }
+
+
+/* RAM shadow of the first PARAM_CACHE_SIZE bytes of EEPROM. 
+ * Reads are served from RAM. Writes update RAM and mark changed bytes 
+ * dirty. They are written back to EEPROM by param_writer thread. 
+ * Bytes written by config_load are also marked as loaded. While 
+ * write-back is held, these are read from EEPROM instead, so that a 
+ * config image is not seen before it is committed. 
+ */
+static uint8_t ee_cache[PARAM_CACHE_SIZE];
+static uint8_t ee_dirty[PARAM_CACHE_SIZE/8];
+static uint8_t ee_loaded[PARAM_CACHE_SIZE/8];
+static uint16_t ee_ndirty = 0;
+static bool cache_on = false;
+static bool cache_hold = false;
+static Cond cache_wr;
+
+#define IN_CACHE(a)  (cache_on && (uint16_t) (a) < PARAM_CACHE_SIZE)
+#define IS_DIRTY(a)  (ee_dirty[(a)>>3] & (1 << ((a) & 0x07)))
+#define IS_LOADED(a) (ee_loaded[(a)>>3] & (1 << ((a) & 0x07)))
+
+static void param_writer(void);
+
+#if PARAM_CACHE_SIZE % 8 != 0
+#error "PARAM_CACHE_SIZE must be a multiple of 8"
+#endif
+#if PARAM_CACHE_SIZE > TRACKLOG_START
+#error "Parameters overlap the track log region in EEPROM"
+#endif
+#if TRACKLOG_START + TRACKLOG_BLOCKS * TRACKLOG_BSIZE > JOURNAL_START
+#error "Track log overlaps the journal region in EEPROM"
+#endif
+
+
+
+/************************************************************************
+ * Load the RAM shadow from EEPROM. Parameters read before this 
+ * is called are read directly from EEPROM. 
+ ************************************************************************/
+
+void param_cache_init()
+{
+   while (!eeprom_is_ready())
+      t_yield();
+   eeprom_read_block(ee_cache, 0, PARAM_CACHE_SIZE);
+   cond_init(&cache_wr);
+   cache_on = true;
+   THREAD_START(param_writer, STACK_PARAMWRITER);
+}
+
+
+
+static uint8_t read_byte(const void* ee_addr)
+{
+   register uint16_t a = (uint16_t) ee_addr;
+   if (IN_CACHE(ee_addr) && !(cache_hold && IS_LOADED(a)))
+      return ee_cache[a];
+   while (!eeprom_is_ready())
+      t_yield();
+   return eeprom_read_byte(ee_addr);
+}
+
+
+
+static void write_byte(void* ee_addr, uint8_t byte)
+{
+   register uint16_t a = (uint16_t) ee_addr;
+   if (IN_CACHE(ee_addr)) {
+      ee_loaded[a>>3] &= ~(1 << (a & 0x07));
+      if (ee_cache[a] == byte)
+         return;
+      ee_cache[a] = byte;
+      if (!IS_DIRTY(a)) {
+         ee_dirty[a>>3] |= (1 << (a & 0x07));
+         ee_ndirty++;
+      }
+      notify(&cache_wr);
+      return;
+   }
+   while (!eeprom_is_ready())
+      t_yield();
+   if (eeprom_read_byte(ee_addr) != byte)
+      eeprom_write_byte(ee_addr, byte);
+}
+
+
+/* Write byte from a config image. Not seen by readers until committed */
+static void load_byte(void* ee_addr, uint8_t byte)
+{
+   register uint16_t a = (uint16_t) ee_addr;
+   write_byte(ee_addr, byte);
+   if (IN_CACHE(ee_addr))
+      ee_loaded[a>>3] |= (1 << (a & 0x07));
+}
+
+
+
+/************************************************************************
+ * Write back dirty bytes of the RAM shadow to EEPROM. 
+ ************************************************************************/
+
+static void param_writer()
+{
+   register uint16_t a;
+   while (true) {
+      while (ee_ndirty == 0 || cache_hold)
+         wait(&cache_wr);
+      for (a=0; a<PARAM_CACHE_SIZE; a++)
+         if (IS_DIRTY(a)) {
+            while (!eeprom_is_ready())
+               t_yield();
+            if (cache_hold) 
+               break;
+            /* May have been flushed or discarded while waiting */
+            if (!IS_DIRTY(a))
+               continue;
+            ee_dirty[a>>3] &= ~(1 << (a & 0x07));
+            ee_ndirty--;
+            eeprom_write_byte((uint8_t*) a, ee_cache[a]);
+         }
+   }
+}
+
+
+
+/************************************************************************
+ * Write all dirty bytes of the RAM shadow to EEPROM before returning.
+ * To be used before reset or jumping to the bootloader. Bytes of a 
+ * config image that is being loaded are not written. 
+ ************************************************************************/
+
+void param_flush()
+{
+   register uint16_t a;
+   for (a=0; a<PARAM_CACHE_SIZE && ee_ndirty > 0; a++)
+      if (IS_DIRTY(a) && !(cache_hold && IS_LOADED(a))) {
+         eeprom_busy_wait();
+         ee_dirty[a>>3] &= ~(1 << (a & 0x07));
+         ee_ndirty--;
+         eeprom_write_byte((uint8_t*) a, ee_cache[a]);
+      }
+   eeprom_busy_wait();
+}
+
+
+
+/************************************************************************
+ * Hold back write-back to EEPROM while a config image is being loaded.
+ * When released, the loaded bytes are made visible if commit is true. 
+ * Otherwise they are restored from EEPROM. Other changes are kept. 
+ * EEPROM must be up to date when the hold starts. 
+ ************************************************************************/
+
+static void param_hold()
+{
+   memset(ee_loaded, 0, sizeof(ee_loaded));
+   cache_hold = true; 
+}
+
+
+static void param_release(bool commit)
+{
+   register uint16_t a;
+   if (commit)
+      param_gen++;
+   else
+      for (a=0; a<PARAM_CACHE_SIZE; a++)
+         if (IS_LOADED(a)) {
+            while (!eeprom_is_ready())
+               t_yield();
+            /* May have been written by another thread while waiting */
+            if (!IS_LOADED(a))
+               continue;
+            ee_cache[a] = eeprom_read_byte((uint8_t*) a);
+            if (IS_DIRTY(a)) {
+               ee_dirty[a>>3] &= ~(1 << (a & 0x07));
+               ee_ndirty--;
+            }
+         }
+   memset(ee_loaded, 0, sizeof(ee_loaded));
+   cache_hold = false;
+   notify(&cache_wr);
+}
+
+
+
+/************************************************************************
+ * Parameters in the config image. The position in this table is the 
+ * record id. Ids must be kept stable: only add entries at the end. 
+ ************************************************************************/
+
+typedef struct {
+   void* addr; 
+   uint8_t size;
+} param_desc_t;
+
+#define PARAM_DESC(x) { &PARAM_##x, sizeof(PARAM_##x) }
+
+static const param_desc_t param_desc[] PROGMEM = {
+   PARAM_DESC( MYCALL ),             PARAM_DESC( DEST ),
+   PARAM_DESC( DIGIS ),              PARAM_DESC( NDIGIS ),
+   PARAM_DESC( TXDELAY ),            PARAM_DESC( TXTAIL ),
+   PARAM_DESC( MAXFRAME ),           PARAM_DESC( TRX_FREQ ),
+   PARAM_DESC( TRX_CALIBRATE ),      PARAM_DESC( TRX_TXPOWER ),
+   PARAM_DESC( TRX_AFSK_DEV ),       PARAM_DESC( TRX_SQUELCH ),
+   PARAM_DESC( TRX_AFC ),            PARAM_DESC( TRACKER_ON ),
+   PARAM_DESC( TRACKER_SLEEP_TIME ), PARAM_DESC( SYMBOL ),
+   PARAM_DESC( SYMBOL_TABLE ),       PARAM_DESC( TIMESTAMP_ON ),
+   PARAM_DESC( COMPRESS_ON ),        PARAM_DESC( ALTITUDE_ON ),
+   PARAM_DESC( REPORT_COMMENT ),     PARAM_DESC( GPS_BAUD ),
+   PARAM_DESC( TRACKER_TURN_LIMIT ), PARAM_DESC( TRACKER_MAXPAUSE ),
+   PARAM_DESC( TRACKER_MINDIST ),    PARAM_DESC( TRACKER_MINPAUSE ),
+   PARAM_DESC( STATUS_TIME ),        PARAM_DESC( REPORT_BEEP ),
+   PARAM_DESC( GPS_POWERSAVE ),      PARAM_DESC( TXMON_ON ),
+   PARAM_DESC( AUTOPOWER ),          PARAM_DESC( OBJ_SYMBOL ),
+   PARAM_DESC( OBJ_SYMBOL_TABLE ),   PARAM_DESC( OBJ_ID ),
+   PARAM_DESC( BOOT_SOUND ),         PARAM_DESC( FAKE_REPORTS ),
+   PARAM_DESC( REPEAT ),             PARAM_DESC( EXTRATURN ),
+   PARAM_DESC( DIGIPEATER_ON ),      PARAM_DESC( DIGIPEATER_WIDE1 ),
+   PARAM_DESC( DIGIPEATER_SAR ),     PARAM_DESC( GPS_UBX ),
+   PARAM_DESC( GPS_UBX_BAUD ),       PARAM_DESC( GPS_STANDBY ),
+   PARAM_DESC( TRACKLOG_ON ),        PARAM_DESC( MICE_ON ),
+   PARAM_DESC( TELEMETRY_ON ),       PARAM_DESC( PERSISTENCE ),
+   PARAM_DESC( SLOTTIME ),           PARAM_DESC( CSMA_ADAPTIVE ),
+   PARAM_DESC( DIGIPEATER_WIDEN ),   PARAM_DESC( DIGIPEATER_PREEMPT ),
+   PARAM_DESC( DIGI_MAXHOPS ),       PARAM_DESC( DIGI_ALIASES ),
+   PARAM_DESC( NDIGI_ALIASES ),      PARAM_DESC( DIGI_VISCOUS ),
+   PARAM_DESC( DIGI_RATE_N ),        PARAM_DESC( DIGI_RATE_WINDOW ),
+   PARAM_DESC( DIGI_MAXDUTY )
+};
+
+#define N_PARAM_DESC (sizeof(param_desc) / sizeof(param_desc_t))
+#define DESC_ADDR(i) ((uint8_t*) pgm_read_word(&param_desc[(i)].addr))
+#define DESC_SIZE(i) pgm_read_byte(&param_desc[(i)].size)
+
+
+
+static uint16_t put_crc(Stream* out, uint8_t x, uint16_t crc)
+{
+   putch(out, x);
+   return _crc_ccitt_update(crc, x);
+}
+
+
+/* Max time (ticks) to wait for next byte of a config image */
+#define CONFIG_TIMEOUT  (10 * TIMER_RESOLUTION)
+
+static bool load_timeout;
+
+/* Read byte from stream. After a timeout, return 0 without waiting */
+static uint8_t get_byte(Stream* in)
+{
+   uint32_t t = timer_ticks();
+   while (stream_empty(in) && !load_timeout) {
+      if (timer_ticks() - t > CONFIG_TIMEOUT)
+         load_timeout = true;
+      else
+         sleep(1);
+   }
+   return (load_timeout ? 0 : getch(in));
+}
+
+
+static uint8_t get_crc(Stream* in, uint16_t* crc)
+{
+   uint8_t x = get_byte(in);
+   *crc = _crc_ccitt_update(*crc, x);
+   return x;
+}
+
+
+
+/************************************************************************
+ * Write all parameters as a binary config image. Format: 
+ *   'P' 'T' <version> <length:16> <records> <crc:16>
+ * where each record is <id> <size> <value> <checksum>. 
+ * 16 bit fields are little endian. The CRC (CCITT) covers all 
+ * bytes before it. 
+ ************************************************************************/
+
+void config_dump(Stream* out)
+{
+   uint16_t crc = 0xffff, len = 0;
+   uint8_t i, j, size;
+   uint8_t* addr;
+   
+   for (i=0; i<N_PARAM_DESC; i++)
+      len += DESC_SIZE(i) + 3;
+   crc = put_crc(out, 'P', crc);
+   crc = put_crc(out, 'T', crc);
+   crc = put_crc(out, CURRENT_VERSION_KEY, crc);
+   crc = put_crc(out, len & 0xff, crc);
+   crc = put_crc(out, len >> 8, crc);
+   for (i=0; i<N_PARAM_DESC; i++) {
+      addr = DESC_ADDR(i);
+      size = DESC_SIZE(i);
+      crc = put_crc(out, i, crc);
+      crc = put_crc(out, size, crc);
+      for (j=0; j<=size; j++)
+         crc = put_crc(out, read_byte(addr+j), crc);
+   }
+   putch(out, crc & 0xff);
+   putch(out, crc >> 8);
+}
+
+
+
+/************************************************************************
+ * Read a binary config image (as written by config_dump) and set 
+ * parameters from it. Images from older versions are accepted: 
+ * records with unknown id or a different size are skipped and 
+ * parameters not in the image are left unchanged. Nothing is changed
+ * unless the whole image is valid: Until the CRC is checked, parameters
+ * are read with their old values. 
+ * Return 0 if ok, 1 if bad header, 2 if CRC error, 3 if timeout. 
+ ************************************************************************/
+
+uint8_t config_load(Stream* in)
+{
+   uint16_t crc = 0xffff, len, rcrc;
+   uint8_t id, size, j, x;
+   
+   load_timeout = false;
+   if (get_crc(in, &crc) != 'P' || get_crc(in, &crc) != 'T')
+      return (load_timeout ? 3 : 1);
+   if (get_crc(in, &crc) > CURRENT_VERSION_KEY)
+      return 1;
+   len = get_crc(in, &crc);
+   len |= (uint16_t) get_crc(in, &crc) << 8;
+   
+   /* Write back earlier changes first. If the image is rejected, the
+    * bytes it wrote are restored from EEPROM. 
+    */
+   param_flush();
+   param_hold();
+   while (len >= 3) {
+      id = get_crc(in, &crc);
+      size = get_crc(in, &crc);
+      len -= 2;
+      bool ok = (id < N_PARAM_DESC && size == DESC_SIZE(id));
+      for (j=0; j<=size && len > 0; j++, len--) {
+         x = get_crc(in, &crc);
+         if (ok)
+            load_byte(DESC_ADDR(id)+j, x);
+      }
+   }
+   while (len-- > 0 && !load_timeout)
+      get_crc(in, &crc);
+   rcrc = get_byte(in);
+   rcrc |= (uint16_t) get_byte(in) << 8;
+   param_release(rcrc == crc && !load_timeout);
+   return (load_timeout ? 3 : (rcrc == crc ? 0 : 2));
+}
 
 
 
@@ -28,17 +394,17 @@ void show_trace(char* buf, uint8_t run, PGM_P pre, PGM_P post)
 
 void reset_param(void* ee_addr, uint8_t size)
 {   
-   while (!eeprom_is_ready())
-      t_yield();
-   eeprom_write_byte(ee_addr+size, 0xff);
+   write_byte(ee_addr+size, 0xff);
+   param_gen++;
 }
 
 
 void reset_all_param()
-{   while (!eeprom_is_ready())
-      t_yield();
-    for (void* eeptr = &FIRST_PARAM;  eeptr <= &LAST_PARAM; eeptr += 2)
-       eeprom_write_byte(eeptr, 0xff);
+{
+    /* Every second byte, up to and including the checksum of the last */
+    for (void* eeptr = &FIRST_PARAM;  eeptr <= (void*) (&LAST_PARAM + 1); eeptr += 2)
+       write_byte(eeptr, 0xff);
+    param_gen++;
 }
 
 
@@ -50,15 +416,14 @@ void set_param(void* ee_addr, const void* ram_addr, uint8_t size)
 {
    register uint8_t byte, checksum = 0x0f;
    
-   while (!eeprom_is_ready())
-      t_yield();
    for (int i=0; i<size; i++)
    {
        byte = *((uint8_t*) ram_addr++);
        checksum ^= byte;
-       eeprom_write_byte(ee_addr++, byte);
+       write_byte(ee_addr++, byte);
    }
-   eeprom_write_byte(ee_addr, checksum);
+   write_byte(ee_addr, checksum);
+   param_gen++;
 }
  
  
@@ -73,15 +438,13 @@ int get_param(const void* ee_addr, void* ram_addr, uint8_t size, PGM_P default_v
    register uint8_t byte, checksum = 0x0f, s_checksum;
    register void* dest = ram_addr;
    
-   while (!eeprom_is_ready())
-      t_yield();
    for (int i=0;i<size; i++)
    {
-       byte = eeprom_read_byte(ee_addr++);
+       byte = read_byte(ee_addr++);
        checksum ^= byte;
        *((uint8_t*) dest++) = byte;
    }
-   s_checksum = eeprom_read_byte(ee_addr);
+   s_checksum = read_byte(ee_addr);
    if (s_checksum != checksum) {
       memcpy_P(ram_addr, default_val, size);
       return 1;
@@ -97,10 +460,9 @@ int get_param(const void* ee_addr, void* ram_addr, uint8_t size, PGM_P default_v
  
 void set_byte_param(uint8_t* ee_addr, uint8_t byte)
 {
-    while (!eeprom_is_ready())
-      t_yield();
-    eeprom_write_byte(ee_addr, byte);
-    eeprom_write_byte(ee_addr+1, (0x0f ^ byte));
+    write_byte(ee_addr, byte);
+    write_byte(ee_addr+1, (0x0f ^ byte));
+    param_gen++;
 }
 
  
@@ -112,15 +474,10 @@ void set_byte_param(uint8_t* ee_addr, uint8_t byte)
  
 uint8_t get_byte_param(const uint8_t* ee_addr, PGM_P default_val)
 {
-    while (!eeprom_is_ready())
-      t_yield();
-    register uint8_t b1 = eeprom_read_byte(ee_addr);
-    register uint8_t b2 = eeprom_read_byte(ee_addr+1);
+    register uint8_t b1 = read_byte(ee_addr);
+    register uint8_t b2 = read_byte(ee_addr+1);
     if ((0x0f ^ b1) == b2)
        return b1;
     else
        return pgm_read_byte(default_val);
 }
-
-
-
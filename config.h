@@ -86,6 +86,25 @@ DEFINE_PARAM( EXTRATURN,          uint8_t      );
 DEFINE_PARAM( DIGIPEATER_ON,      uint8_t      );
 DEFINE_PARAM( DIGIPEATER_WIDE1,   uint8_t      );
 DEFINE_PARAM( DIGIPEATER_SAR,     uint8_t      );
+DEFINE_PARAM( GPS_UBX,            uint8_t      );
+DEFINE_PARAM( GPS_UBX_BAUD,       uint16_t     );
+DEFINE_PARAM( GPS_STANDBY,        uint8_t      );
+DEFINE_PARAM( TRACKLOG_ON,        uint8_t      );
+DEFINE_PARAM( MICE_ON,            uint8_t      );
+DEFINE_PARAM( TELEMETRY_ON,       uint8_t      );
+DEFINE_PARAM( PERSISTENCE,        uint8_t      );
+DEFINE_PARAM( SLOTTIME,           uint8_t      );
+DEFINE_PARAM( CSMA_ADAPTIVE,      uint8_t      );
+DEFINE_PARAM( DIGIPEATER_WIDEN,   uint8_t      );
+DEFINE_PARAM( DIGIPEATER_PREEMPT, uint8_t      );
+DEFINE_PARAM( DIGI_MAXHOPS,       uint8_t      );
+DEFINE_PARAM( DIGI_ALIASES,       __digilist_t );
+DEFINE_PARAM( NDIGI_ALIASES,      uint8_t      );
+DEFINE_PARAM( DIGI_VISCOUS,       uint8_t      );
+DEFINE_PARAM( DIGI_RATE_N,        uint8_t      );
+DEFINE_PARAM( DIGI_RATE_WINDOW,   uint8_t      );
+DEFINE_PARAM( DIGI_MAXDUTY,       uint8_t      );
+/* Add new parameters here, and set LAST_PARAM (below) to the last one */
 
 extern __trace_t trace           __attribute__ ((section (".noinit")));
 extern uint8_t   trace_index[]   __attribute__ ((section (".noinit")));
@@ -141,14 +160,34 @@ DEFAULT_PARAM( EXTRATURN )           = 0;
 DEFAULT_PARAM( DIGIPEATER_ON )       = 0;
 DEFAULT_PARAM( DIGIPEATER_WIDE1 )    = 0;
 DEFAULT_PARAM( DIGIPEATER_SAR)       = 1;
+DEFAULT_PARAM( GPS_UBX )             = 0;
+DEFAULT_PARAM( GPS_UBX_BAUD )        = 38400;
+DEFAULT_PARAM( GPS_STANDBY )         = 0;
+DEFAULT_PARAM( TRACKLOG_ON )         = 0;
+DEFAULT_PARAM( MICE_ON )             = 0;
+DEFAULT_PARAM( TELEMETRY_ON )        = 0;
+DEFAULT_PARAM( PERSISTENCE )         = 199;
+DEFAULT_PARAM( SLOTTIME )            = 50;
+DEFAULT_PARAM( CSMA_ADAPTIVE )       = 0;
+DEFAULT_PARAM( DIGIPEATER_WIDEN )    = 0;
+DEFAULT_PARAM( DIGIPEATER_PREEMPT )  = 0;
+DEFAULT_PARAM( DIGI_MAXHOPS )        = 2;
+DEFAULT_PARAM( DIGI_ALIASES )        = {{"",0}};
+DEFAULT_PARAM( NDIGI_ALIASES )       = 0;
+DEFAULT_PARAM( DIGI_VISCOUS )        = 0;
+DEFAULT_PARAM( DIGI_RATE_N )         = 0;
+DEFAULT_PARAM( DIGI_RATE_WINDOW )    = 10;
+DEFAULT_PARAM( DIGI_MAXDUTY )        = 0;
 
 __trace_t trace            __attribute__ ((section (".noinit")));
 uint8_t   trace_index[2]   __attribute__ ((section (".noinit")));
 
 #endif
  
+/* First and last parameter in EEPROM. Reset to defaults covers all 
+ * parameters between them. */
 #define FIRST_PARAM PARAM_MYCALL
-#define LAST_PARAM PARAM_FAKE_REPORTS
+#define LAST_PARAM PARAM_DIGI_MAXDUTY
 
 
 /***************************************************************
@@ -167,6 +206,11 @@ void    set_param(void*, const void*, uint8_t);
 int     get_param(const void*, void*, uint8_t, PGM_P);
 void    set_byte_param(uint8_t*, uint8_t);
 uint8_t get_byte_param(const uint8_t*, PGM_P);
+uint16_t param_generation(void);
+void    param_cache_init(void);
+void    param_flush(void);
+void    config_dump(Stream*);
+uint8_t config_load(Stream*);
 
 
 /* Tracing. 
@@ -1,3 +1,6 @@
+#if !defined __DEFINES_H__
+#define __DEFINES_H__
+
 
 #include <stdint.h>
 #include <stdio.h>
@@ -21,6 +24,19 @@
 #define GPS_FIX_TIME     3  
 #define PACKET_TX_TIME   2
 
+/*
+ *  GPS power management: 
+ *   - Max time (sec) GPS can be off and still be expected to do a hot start
+ *   - Initial estimate of time (sec) to get a fix after a longer off period
+ *   - Typical current (mA) drawn by GPS receiver when on
+ *   - Typical current (mA) drawn by transmitter when on (airtime accounting)
+ */
+ 
+#define GPS_HOT_TIME      1800
+#define GPS_WARM_FIX_TIME 35
+#define GPS_CURRENT       30
+#define TX_CURRENT        35
+
 
 /********************************************
  *  Software version, etc
@@ -39,6 +55,9 @@
 #define KNOTS2MPS 0.5148
 #define FEET2M 3.2898
 
+/* Speed in km/h to posdata_t speed (1/100 knots) */
+#define KMH2SPEED(x) ((uint16_t) ((x) * 100 / KNOTS2KMH))
+
 
 /********************************************
  * Note: The CPU frequency must be defined
@@ -66,10 +85,12 @@
 #define STACK_HDLCENCODER_TEST 120
 #define STACK_GPSLISTENER      310
 #define STACK_TRACKER          310   
-#define STACK_MONITOR          260 
+#define STACK_MONITOR          340 
 #define STACK_USB              100 
 #define STACK_DIGIPEATER       310
-#define STACK_HLIST_TICK       110 
+#define STACK_DIGI_DELAY       100
+#define STACK_KISS             120
+#define STACK_PARAMWRITER      90
 
 
 
@@ -81,12 +102,33 @@
 #define FBUF_SLOTS         80
 #define FBUF_SLOTSIZE      24
 
+/* Size of RAM shadow of EEPROM parameters. Must be a multiple of 8
+ * and must cover all parameters (checked by the makefile).
+ */
+#define PARAM_CACHE_SIZE   328
+
+/* Track log. Region in EEPROM between parameters and journal */
+#define TRACKLOG_START     0x0200
+#define TRACKLOG_BLOCKS    48
+#define TRACKLOG_BSIZE     64
+
+/* Journal for runtime state. Region in EEPROM after parameters */
+#define JOURNAL_START      0x0E00
+#define JOURNAL_SLOTS      73
+
 
 #define AFSK_ENCODER_BUFFER_SIZE 128
 #define AFSK_DECODER_BUFFER_SIZE 128
 #define HDLC_DECODER_QUEUE_SIZE  7
 #define HDLC_ENCODER_QUEUE_SIZE  7
 
+/* Channel statistics: Samples per second (afsk_check_channel is called 
+ * every 60 ticks of the 2400 Hz timer interrupt). Busy percentage (10 min) 
+ * above which the tracker doubles the minimum pause in adaptive CSMA mode.
+ */
+#define CHANSTAT_RATE      40
+#define CHANNEL_BUSY_LIMIT 50
+
 
 /********************************************
  * LED blinking
@@ -391,3 +433,5 @@ do {                        \
 static inline uint8_t xtoi (char d) {
   return (isdigit (d)) ? d - 48 : toupper (d) - ('A' - 10);
 }
+
+#endif /* __DEFINES_H__ */
@@ -7,115 +7,438 @@
  *    DIGIPEATER_WIDE1  - true if wide1/fill-in digipeater mode. Meaning that only WIDE1 alias will be reacted on. 
  *    DIGIPEATER_SAR    - true if SAR preemption mode. If an alias SAR is found anywhere in the path, it will 
  *                        preempt others (moved first) and digipeated upon.  
+ *    DIGIPEATER_WIDEN  - true if full WIDEn-N and TRACEn-N handling (for hilltop digipeaters). 
+ *    DIGIPEATER_PREEMPT - true if own callsign or alias will be digipeated upon anywhere in the path.
+ *                        Unused path elements before it are removed. 
+ *    DIGI_MAXHOPS      - WIDEn-N and TRACEn-N with n larger than this are not digipeated. 
+ *    DIGI_ALIASES      - list of user defined aliases (e.g. RELAY). Callsign and SSID must match.
+ *    DIGI_VISCOUS      - viscous delay (seconds). If nonzero, frames are held for this time before 
+ *                        they are sent, and dropped if another digipeater is heard repeating them first.
+ *    DIGI_RATE_N       - max number of frames digipeated per source callsign in DIGI_RATE_WINDOW
+ *                        (minutes). 0 means no limit. 
+ *    DIGI_MAXDUTY      - don't digipeat if transmitter duty cycle (percent) is at or above this. 
+ *                        0 means no limit. 
+ * 
+ * Path processing (first unused element of path): 
+ *    MYCALL or alias   - replaced with MYCALL*
+ *    WIDE1-1           - replaced with MYCALL*,WIDE1*
+ *    WIDEn-N           - N is decremented (WIDEn* when N reaches 0)
+ *    TRACEn-N          - MYCALL* is inserted and N is decremented
  * 
  * Macros for configuration (defined in defines.h)
  *    HDLC_DECODER_QUEUE_SIZE - size (in packets) of receiving queue. Normally 7.
  *    STACK_DIGIPEATER        - size of stack for digipeater task.
- *    STACK_HLIST_TICK        - size of stack for tick_thread (for heard list).
+ *    STACK_DIGI_DELAY        - size of stack for viscous delay task.
  *   
  */
 
 #include "kernel/kernel.h"
+#include "kernel/timer.h"
 #include "kernel/stream.h"
 #include "defines.h"
 #include "config.h"
 #include "ax25.h"
 #include "hdlc.h"
 #include "digipeater.h"
+#include "afsk.h"
+#include "radio.h"
+#include "ui.h"
 #include <util/crc16.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
 #include <string.h>
    
 static bool digi_on = false;
+static bool digi_alive = false, delay_alive = false;
 static FBQ rxqueue;
-static void digi_thread(void);
 
 extern fbq_t* outframes; 
 extern fbq_t* mon_q;
 
-static void tick_thread(void);
 static void digipeater_thread(void);
-static bool duplicate_packet(addr_t* from, addr_t* to, FBUF* f, uint8_t ndigis);
-static uint16_t digi_checksum(addr_t* from, addr_t* to, FBUF* f, uint8_t ndigis);
+static void delay_thread(void);
+static bool duplicate_packet(FBUF* f);
 static void check_frame(FBUF *f);
+static void send_frame(FBUF *f, uint16_t hash);
+static uint8_t tx_duty(void);
+static void digi_wakeup(void);
+
+
+/* Frames held back for viscous delay. Since they all have the same 
+ * delay, they are kept in a FIFO queue. A held frame is cancelled
+ * if its hash is heard again before its timer expires. 
+ */
+typedef struct {
+    FBUF frame;
+    uint16_t hash;
+    bool cancelled;
+    Timer tmr;
+} held_t;
+
+static held_t held[DIGI_DELAY_SLOTS];
+static uint8_t h_first = 0, h_count = 0;
+static Cond h_cond;
+
+
+/* Alias table. Callsigns are stored pre-encoded in shifted AX.25 form
+ * so that matching is a memcmp on the address field of the frame. The 
+ * table is rebuilt when parameters have been changed. 
+ */
+#define ALIAS_NONE   0
+#define ALIAS_EXACT  1    /* MYCALL or user alias. Callsign and SSID must match */
+#define ALIAS_WIDE   2    /* WIDEn-N */
+#define ALIAS_TRACE  3    /* TRACEn-N */
+#define ALIAS_SAR    4    /* SAR with any SSID */
+
+#define N_ALIASES   11    /* 3 built-in, MYCALL and up to 7 user aliases */
+
+typedef struct {
+    uint8_t call[6];
+    uint8_t ssid;         /* Encoded SSID bits */
+    uint8_t len, type;    /* Number of octets to compare, alias type */
+} alias_t;
+
+static alias_t aliases[N_ALIASES];
+static uint8_t naliases = 0;
+static uint16_t alias_gen;
+
+/* Statistics */
+static uint16_t n_digi, n_dupes, n_cancelled, n_rate, n_duty;
+
+/* Time and PTT time (ticks) at start of duty cycle measurement periods */
+static uint32_t d_time[2], d_ptt[2];
 
 
 
 void digipeater_init()
 {
     FBQ_INIT(rxqueue, HDLC_DECODER_QUEUE_SIZE);
+    cond_init(&h_cond);
 }
 
 
 /***************************************************************
  * Activate the digipeater if argument is true
  * Deactivate if false
+ *
+ * The threads have static TCBs and stacks, so they cannot be 
+ * started again before the threads of the previous session have 
+ * terminated. 
  ***************************************************************/
 
 void digipeater_activate(bool m)
 { 
-   bool tstart = m && !digi_on;
-   bool tstop = !m && digi_on;
-   
-   digi_on = m;
-   FBQ* mq = (digi_on? &rxqueue : NULL);
- 
-   if (tstart) {
+   if (m && !digi_on) {
+      while (digi_alive || delay_alive) {
+         digi_wakeup();
+         sleep(5);
+      }
+      digi_on = digi_alive = delay_alive = true;
+      
       /* Subscribe to RX packets and start treads */
-      hdlc_subscribe_rx(mq, 1);
+      hdlc_subscribe_rx(&rxqueue, 1);
       THREAD_START(digipeater_thread, STACK_DIGIPEATER);  
-      THREAD_START(tick_thread, STACK_HLIST_TICK);
+      THREAD_START(delay_thread, STACK_DIGI_DELAY);
       
       /* Turn on radio and decoder */
       radio_require();
       afsk_enable_decoder();
    } 
-   if (tstop) {
-     /* Turn off radio and decoder */
+   else if (!m && digi_on) {
+      digi_on = false;
+      
+      /* Turn off radio and decoder */
       afsk_disable_decoder();
       radio_release();
       
       /* Unsubscribe to RX packets and stop threads */
       hdlc_subscribe_rx(NULL, 1);
+      digi_wakeup();
+   }
+}
+
+
+
+/***************************************************************
+ * Wake up threads to let them terminate. The digipeater thread 
+ * may wait for a frame. Don't signal it if the queue is not 
+ * empty, since putting a frame would then block when it is 
+ * full. The delay thread drops held frames when their timers are 
+ * cancelled. 
+ ***************************************************************/
+
+static void digi_wakeup()
+{
+   uint8_t i;
+   if (digi_alive && fbq_eof(&rxqueue))
       fbq_signal(&rxqueue);
+   for (i=0; i<h_count; i++)
+      timer_cancel(&held[(h_first + i) % DIGI_DELAY_SLOTS].tmr);
+   notify(&h_cond);
+}
+
+
+/*******************************************************************************
+ * Show digipeater statistics
+ *******************************************************************************/
+
+void digipeater_show(Stream* out)
+{
+   char buf[80];
+   sprintf_P(buf, PSTR("Digipeated: %u, duplicates: %u, cancelled (viscous): %u\r\n"),
+      n_digi, n_dupes, n_cancelled);
+   putstr(out, buf);
+   sprintf_P(buf, PSTR("Dropped: %u (rate limit), %u (duty cycle). TX duty: %u%%\r\n"),
+      n_rate, n_duty, tx_duty());
+   putstr(out, buf);
+}
+
+
+
+/*******************************************************************************
+ * Cancel held frames with the given hash, i.e. another digipeater has been 
+ * heard repeating it. The delay thread will drop them. 
+ *******************************************************************************/
+
+static void cancel_held(uint16_t hash)
+{
+   held_t* h;
+   uint8_t i;
+   for (i=0; i<h_count; i++) {
+      h = &held[(h_first + i) % DIGI_DELAY_SLOTS];
+      if (h->hash == hash && !h->cancelled) {
+         n_cancelled++;
+         h->cancelled = true;
+         timer_cancel(&h->tmr);
+      }
+   }
+}
+
+
+
+/*******************************************************************************
+ * Send digipeated frame. If viscous delay is set, hold it back. Send it 
+ * at once if no free slots. 
+ *******************************************************************************/
+
+static void send_frame(FBUF* f, uint16_t hash)
+{
+   uint8_t delay = GET_BYTE_PARAM(DIGI_VISCOUS);
+   held_t* h;
+   
+   if (delay == 0 || h_count == DIGI_DELAY_SLOTS) {
+      n_digi++;
+      beeps("..");
+      fbq_put(outframes, *f);
+      return;
    }
+   h = &held[(h_first + h_count) % DIGI_DELAY_SLOTS];
+   h->frame = *f;
+   h->hash = hash;
+   h->cancelled = false;
+   timer_set(&h->tmr, delay * TIMER_RESOLUTION);
+   h_count++;
+   notify(&h_cond);
 }
 
 
+
 /*******************************************************************************
  * Return true if packet is heard earlier. 
- * If not, put it into the heard list. 
+ * If not, put it into the heard list. The hash of source-callsign + 
+ * destination-callsign + message is computed by the HDLC decoder while 
+ * the frame is received. 
  *******************************************************************************/
 
-static bool duplicate_packet(addr_t* from, addr_t* to, FBUF* f, uint8_t ndigis)
+static bool duplicate_packet(FBUF* f)
 { 
-   uint16_t cs = digi_checksum(from, to, f, ndigis);
-   bool hrd = hlist_exists(cs);
-   if (!hrd) hlist_add(cs);
+   bool hrd = hlist_exists(f->hash);
+   if (!hrd) hlist_add(f->hash);
+   else {
+      n_dupes++;
+      cancel_held(f->hash);
+   }
    return hrd;
 }
 
 
 
-/*********************************************************************************
- * Compute a checksum (hash) from source-callsign + destination-callsign 
- * + message. This is used to check for duplicate packets. 
- *********************************************************************************/
+/*******************************************************************************
+ * Transmitter duty cycle (percent) over the last 1-2 DIGI_DUTY_WINDOW 
+ * periods. This includes all transmissions, not just digipeated frames. 
+ * After a longer pause, the old sample would stretch the period and 
+ * underestimate the duty cycle, so both samples are restarted. The 
+ * period is at least one window, so that a single frame right after 
+ * a restart does not count as a high duty cycle. 
+ *******************************************************************************/
+
+static uint8_t tx_duty()
+{
+   uint32_t t = timer_ticks();
+   uint32_t p = afsk_ptt_ticks();
+   uint32_t dt;
+   
+   if (t - d_time[1] >= 2 * DIGI_DUTY_WINDOW) {
+      d_time[0] = d_time[1] = t;
+      d_ptt[0] = d_ptt[1] = p;
+   }
+   else if (t - d_time[1] >= DIGI_DUTY_WINDOW) {
+      d_time[0] = d_time[1];
+      d_ptt[0] = d_ptt[1];
+      d_time[1] = t;
+      d_ptt[1] = p;
+   }
+   dt = t - d_time[0];
+   if (dt < DIGI_DUTY_WINDOW)
+      dt = DIGI_DUTY_WINDOW;
+   return (p - d_ptt[0]) * 100 / dt;
+}
+
+
+
+/*******************************************************************************
+ * Return true if frame can be digipeated within the TX duty cycle ceiling
+ * and the rate limit for its source callsign. Count frames that are dropped. 
+ *******************************************************************************/
+
+static bool rate_ok(ax25_hdr_t* h)
+{
+   uint8_t maxduty = GET_BYTE_PARAM(DIGI_MAXDUTY);
+   uint8_t n = GET_BYTE_PARAM(DIGI_RATE_N);
+   uint8_t a[7], i;
+   uint16_t key = 0xFFFF;
+   
+   if (maxduty > 0 && tx_duty() >= maxduty) {
+      n_duty++;
+      return false;
+   }
+   if (n > 0) {
+      ax25_addr_raw(h, AX25_FROM, a);
+      for (i=0; i<6; i++)
+         key = _crc_ccitt_update(key, a[i]);
+      key = _crc_ccitt_update(key, a[6] & 0x1E);
+      if (!rlist_allow(key, n, GET_BYTE_PARAM(DIGI_RATE_WINDOW) * 60)) {
+         n_rate++;
+         return false;
+      }
+   }
+   return true;
+}
+
+
+
+/*******************************************************************
+ * Build alias table from parameters, if they have been changed.
+ *******************************************************************/
+
+static void add_alias(const addr_t* a, uint8_t type)
+{
+   alias_t* x = &aliases[naliases++];
+   const char* c = a->callsign;
+   uint8_t i;
+   
+   for (i=0; i<6; i++)
+      x->call[i] = (*c ? *(c++) : ASCII_SPC) << 1;
+   x->ssid = (a->ssid & 0x0F) << 1;
+   x->len = (type == ALIAS_EXACT ? 6 : strlen(a->callsign));
+   x->type = type;
+}
+
+
+static void update_aliases()
+{
+   __digilist_t user;
+   addr_t a;
+   uint8_t i, n;
+   
+   if (naliases > 0 && alias_gen == param_generation())
+      return;
+   alias_gen = param_generation();
+   naliases = 0;
+   str2addr(&a, "WIDE", false);
+   add_alias(&a, ALIAS_WIDE);
+   str2addr(&a, "TRACE", false);
+   add_alias(&a, ALIAS_TRACE);
+   str2addr(&a, "SAR", false);
+   add_alias(&a, ALIAS_SAR);
+   GET_PARAM(MYCALL, &a);
+   add_alias(&a, ALIAS_EXACT);
+   
+   n = GET_BYTE_PARAM(NDIGI_ALIASES);
+   GET_PARAM(DIGI_ALIASES, &user);
+   for (i=0; i<n && i<7; i++)
+      add_alias(&user[i], ALIAS_EXACT);
+}
+
+
+
+/*******************************************************************
+ * Match address k of frame against the alias table. Return the 
+ * matching entry or NULL. For WIDEn-N and TRACEn-N, n and N are 
+ * returned in the last two arguments. 
+ *******************************************************************/
+
+static alias_t* match_alias(ax25_hdr_t* h, uint8_t k, uint8_t* n, uint8_t* N)
+{
+   uint8_t a[7], i;
+   alias_t* x;
+   
+   ax25_addr_raw(h, k, a);
+   for (x = aliases; x < aliases + naliases; x++) {
+      if (memcmp(a, x->call, x->len) != 0)
+         continue;
+      if (x->type == ALIAS_EXACT) {
+         if ((a[6] & 0x1E) == x->ssid)
+            return x;
+      }
+      else if (x->type == ALIAS_SAR)
+         return x;
+      else {
+         /* Prefix is followed by a digit n and blanks. SSID is N */
+         *n = (a[x->len] >> 1) - '0';
+         *N = (a[6] & 0x1E) >> 1;
+         for (i = x->len+1; i<6 && a[i] == (ASCII_SPC << 1); i++)
+            ;
+         if (i == 6 && *n >= 1 && *n <= 7)
+            return x;
+      }
+   }
+   return NULL;
+}
+
+
+
+/*******************************************************************
+ * Return position of first alias of given type in path from 
+ * position i. -1 if not found. 
+ *******************************************************************/
+
+static int8_t find_alias(ax25_hdr_t* h, uint8_t i, uint8_t ndigis, uint8_t type)
+{
+   uint8_t n, N;
+   alias_t* x;
+   
+   for (; i<ndigis; i++)
+      if ((x = match_alias(h, AX25_DIGI(i), &n, &N)) != NULL && x->type == type)
+         return i;
+   return -1;
+}
+
+
+
+/*******************************************************************
+ * Return true if WIDEn-N or TRACEn-N is to be digipeated. 
+ * WIDE1-1 is accepted in fill-in mode. Others need WIDEn-N mode 
+ * and n within the hop limit. 
+ *******************************************************************/
 
-static uint16_t digi_checksum(addr_t* from, addr_t* to, FBUF* f, uint8_t ndigis)
+static bool widen_ok(uint8_t type, uint8_t n, uint8_t N)
 {
-  uint16_t crc = 0xFFFF;
-  uint8_t i = 0;
-  while (from->callsign[i] != 0)
-    crc = _crc_ccitt_update(crc, from->callsign[i++]); 
-  crc = _crc_ccitt_update(crc, from->ssid);
-  i=0;
-  while (to->callsign[i] != 0)
-    crc = _crc_ccitt_update(crc, to->callsign[i++]);
-  crc = _crc_ccitt_update(crc, to->ssid);
-  fbuf_rseek(f, 14+2+ndigis*7); 
-  for (i=0; i<fbuf_length(f)-2; i++)
-     crc = _crc_ccitt_update(crc, fbuf_getChar(f)); 
-  return crc;
+   if (N < 1 || N > n)
+      return false;
+   if (type == ALIAS_WIDE && n == 1 && GET_BYTE_PARAM(DIGIPEATER_WIDE1))
+      return true;
+   return GET_BYTE_PARAM(DIGIPEATER_WIDEN) && n <= GET_BYTE_PARAM(DIGI_MAXHOPS);
 }
 
 
@@ -123,82 +446,151 @@ static uint16_t digi_checksum(addr_t* from, addr_t* to, FBUF* f, uint8_t ndigis)
 /*******************************************************************
  * Check a frame if it is to be digipeated
  * If yes, digipeat it :)
+ * The decision is made on a header view. Addresses are only 
+ * copied if the frame is to be digipeated. 
  *******************************************************************/
 
 static void check_frame(FBUF *f)
 {
    FBUF newHdr;
+   ax25_hdr_t hdr;
    addr_t mycall, from, to; 
-   addr_t digis[7], digis2[7];
-   bool widedigi = false;
-   uint8_t ctrl, pid;
-   uint8_t i, j; 
-   int8_t  sar_pos = -1;
-   uint8_t ndigis =  ax25_decode_header(f, &from, &to, digis, &ctrl, &pid);
-
-   if (duplicate_packet(&from, &to, f, ndigis))
+   addr_t digis2[7];
+   alias_t* al = NULL;
+   uint8_t type = ALIAS_NONE;
+   uint8_t i, j, ndigis, n = 0, N = 0; 
+   int8_t  sar_pos = -1, pre_pos = -1;
+   bool insert = true;
+   
+   if (duplicate_packet(f))
        return;
-   GET_PARAM(MYCALL, &mycall);
+   if (!ax25_hdr_view(&hdr, f))
+       return;
+   ndigis = ax25_hdr_ndigis(&hdr);
 
-   /* Copy items in digi-path that has digi flag turned on, 
+   /* Skip items in digi-path that has digi flag turned on, 
     * i.e. the digis that the packet has been through already 
     */
-   for (i=0; i<ndigis && (digis[i].flags & FLAG_DIGI); i++) 
-       digis2[i] = digis[i];   
+   for (i=0; i<ndigis && ax25_addr_hbit(&hdr, AX25_DIGI(i)); i++) 
+       ;   
 
    /* Return if it has been through all digis in path */
    if (i==ndigis)
        return;
 
-   if (GET_BYTE_PARAM(DIGIPEATER_WIDE1) 
-           && strncasecmp("WIDE1", digis[i].callsign, 5) == 0 && digis[i].ssid == 1)
-       widedigi = true; 
-  
    /* Look for SAR alias in the rest of the path 
     * NOTE: Don't use SAR-preemption if packet has been digipeated by others first 
     */    
    if (GET_BYTE_PARAM(DIGIPEATER_SAR) && i<=0) 
-     for (j=i; j<ndigis; j++)
-       if (strncasecmp("SAR", digis[j].callsign, 3) == 0) 
-          { sar_pos = j; break; } 
+       sar_pos = find_alias(&hdr, i, ndigis, ALIAS_SAR);
    
-   /* Return if no SAR preemtion and WIDE1 alias not found first */
-   if (sar_pos < 0 && !widedigi)
-      return;
+   if (sar_pos < 0) {
+       al = match_alias(&hdr, AX25_DIGI(i), &n, &N);
+       if (al != NULL)
+          type = al->type;
+       if (type == ALIAS_WIDE || type == ALIAS_TRACE) {
+          if (!widen_ok(type, n, N))
+             return;
+          
+          /* Plain WIDEn-N (n>1) is only decremented. Don't insert
+           * MYCALL if the path is full. 
+           */
+          insert = (type == ALIAS_TRACE || n == 1) && ndigis < 7;
+       }
+       else if (type != ALIAS_EXACT) {
+          /* Preemption: Look for own callsign or alias in the rest of the path */
+          if (GET_BYTE_PARAM(DIGIPEATER_PREEMPT))
+             pre_pos = find_alias(&hdr, i+1, ndigis, ALIAS_EXACT);
+          if (pre_pos < 0)
+             return;
+       }
+   }
 
-   /* Mark as digipeated through mycall */
-   j = i;
-   mycall.flags = FLAG_DIGI;
-   digis2[j++] = mycall; 
+   /* It is for us. Drop it if source or transmitter exceeds limits */
+   if (!rate_ok(&hdr))
+       return;
    
+   /* Copy addresses and the part of the path that 
+    * the packet has been through already
+    */
+   GET_PARAM(MYCALL, &mycall);
+   ax25_addr_get(&hdr, AX25_FROM, &from);
+   ax25_addr_get(&hdr, AX25_TO, &to);
+   for (j=0; j<i; j++)
+       ax25_addr_get(&hdr, AX25_DIGI(j), &digis2[j]);
+
+   /* Mark as digipeated through mycall */
+   if (insert) {
+       mycall.flags = FLAG_DIGI;
+       digis2[j++] = mycall; 
+   }
    
    /* do SAR preemption if requested  */
    if (sar_pos > -1) 
        str2addr(&digis2[j++], "SAR", true);
  
-   /* Otherwise, use wide digipeat method if requested and allowed */
-   else if (widedigi) {
+   /* Preemption: Skip unused part of path before own callsign or alias */
+   else if (pre_pos > -1)
+       i = pre_pos + 1;
+   
+   /* Own callsign or alias is replaced by mycall */
+   else if (type == ALIAS_EXACT)
        i++;
-       str2addr(&digis2[j++], "WIDE1", true);
+       
+   /* WIDEn-N or TRACEn-N: Decrement N. Mark as used when it reaches 0 */
+   else {
+       ax25_addr_get(&hdr, AX25_DIGI(i++), &digis2[j]);
+       digis2[j].ssid = N-1;
+       digis2[j++].flags = (N == 1 ? FLAG_DIGI : 0);
    }
 
    /* Copy rest of the path, exept the SAR alias (if used) */
-   for (; i<ndigis; i++) 
+   for (; i<ndigis && j<7; i++) 
        if (sar_pos < 0 || i != sar_pos)
-          digis2[j++] = digis[i];
+          ax25_addr_get(&hdr, AX25_DIGI(i), &digis2[j++]);
    
    /* Write a new header -> newHdr */
    fbuf_new(&newHdr);
-   ax25_encode_header(&newHdr, &from, &to, digis2, j, ctrl, pid);
+   ax25_encode_header(&newHdr, &from, &to, digis2, j, hdr.ctrl, hdr.pid);
 
    /* Replace header in original packet with new header. 
     * Do this non-destructively: Just add rest of existing packet to new header 
     */
-   fbuf_connect(&newHdr, f, AX25_HDR_LEN(ndigis) );
+   fbuf_connect(&newHdr, f, ax25_hdr_len(&hdr));
 
    /* Send packet */
-   beeps("..");
-   fbq_put(outframes, newHdr);  
+   send_frame(&newHdr, f->hash);
+}
+
+
+
+
+/*******************************************************************
+ * Send held frames when their delay expires, unless cancelled.
+ *******************************************************************/
+
+static void delay_thread()
+{
+    held_t* h;
+    while (digi_on || h_count > 0)
+    {
+        if (h_count == 0) {
+            wait(&h_cond);
+            continue;
+        }
+        h = &held[h_first];
+        timer_wait(&h->tmr);
+        if (h->cancelled || !digi_on)
+            fbuf_release(&h->frame);
+        else {
+            n_digi++;
+            beeps("..");
+            fbq_put(outframes, h->frame);
+        }
+        h_first = (h_first + 1) % DIGI_DELAY_SLOTS;
+        h_count--;
+    }
+    delay_alive = false;
 }
 
 
@@ -218,23 +610,16 @@ static void digipeater_thread()
         }
         
         /* Do something about it */
+        update_aliases();
         check_frame(&frame);
         
         /* And dispose it */
         fbuf_release(&frame);
     }
     beeps("-.. ..-.  ");
+    digi_alive = false;
 }
 
 
 
-static void tick_thread() 
-{
-    while (digi_on) {
-       sleep(500);
-       hlist_tick();
-    }
-}
-
-
 
@@ -1,13 +1,36 @@
  #if !defined __DIGIPEATER_H__
  #define __DIGIPEATER_H__
  
- #define HEARDLIST_SIZE 32
- #define HEARDLIST_MAX_AGE 6
+ #include "kernel/stream.h"
+ 
+ /* Heard list: Number of slots (power of 2), max number of slots 
+  * probed for each entry, and time (seconds) entries are kept. 
+  */
+ #define HEARDLIST_SIZE 64
+ #define HEARDLIST_PROBES 8
+ #define HEARDLIST_MAX_AGE 30
+ 
+ /* Max number of frames held back for viscous delay */
+ #define DIGI_DELAY_SLOTS 4
+ 
+ /* Rate limit table: Number of slots (power of 2) and max number 
+  * of slots probed for each source. 
+  */
+ #define RATELIMIT_SIZE 128
+ #define RATELIMIT_PROBES 4
+ 
+ /* Time (ticks) for measuring transmitter duty cycle. Duty cycle is
+  * measured over the last 1-2 such periods. 
+  */
+ #define DIGI_DUTY_WINDOW 6000
  
  void digipeater_init(void);
  void digipeater_activate(bool m);
+ void digipeater_show(Stream* out);
  
  bool hlist_exists(uint16_t x);
  void hlist_add(uint16_t x);
  
+ bool rlist_allow(uint16_t key, uint8_t n, uint16_t window);
+ 
  #endif /* __DIGIPEATER_H__ */
\ No newline at end of file
@@ -84,6 +84,7 @@ void fbuf_new (FBUF* bb)
     bb->head = bb->wslot = bb->rslot = _fbuf_newslot();
     bb->rpos = 0;
     bb->length = 0;
+    bb->hash = 0;
 }
 
 
@@ -123,6 +124,7 @@ FBUF fbuf_newRef(FBUF* bb)
   } 
   newb.head = bb->head; 
   newb.length = bb->length; 
+  newb.hash = bb->hash;
   fbuf_reset(&newb);
   newb.wslot = bb->wslot;
   return newb;
@@ -372,7 +374,10 @@ char* fbuf_read (FBUF* b, uint8_t size, char *buf)
 
 
 /*******************************************************
-  Remove the last byte of a buffer chain.
+  Remove the last byte of a buffer chain. The length of
+  the chain is reduced by one. If the last slot becomes 
+  empty, it is released and writing continues at the end
+  of the previous slot. 
  *******************************************************/
 
 void fbuf_removeLast(FBUF* x)
@@ -387,11 +392,13 @@ void fbuf_removeLast(FBUF* x)
   }
   
   _fbuf_length[xlast]--;
+  x->length--;
   if (_fbuf_length[xlast] == 0 && prev != xlast) {
     _fbuf_refcnt[xlast]--;
     if (_fbuf_refcnt[xlast] == 0)
       _free_slots++;
     _fbuf_next[prev] = NILPTR;
+    x->wslot = prev;
   }
 }
 
@@ -18,6 +18,7 @@ typedef struct _fb
 {
    uint8_t head, wslot, rslot, rpos; 
    uint8_t length;
+   uint16_t hash;     /* Duplicate check hash. Set by HDLC decoder */
 }
 FBUF; 
 
@@ -39,6 +40,7 @@ char  fbuf_getChar  (FBUF* b);
 char* fbuf_read     (FBUF* b, uint8_t size, char *buf);
 void  fbuf_insert   (FBUF* b, FBUF* x, uint8_t pos);
 void  fbuf_connect  (FBUF* b, FBUF* x, uint8_t pos);
+void  fbuf_removeLast(FBUF* b);
 
 uint8_t fbuf_freeSlots(void);
 
@@ -72,7 +74,7 @@ void  fbq_signal(FBQ* q);
 // #define fbq_length(q) ((q)->length.cnt)
 #define fbq_eof(q)    ((q)->capacity.cnt >= (q)->size)
 
-#define FBQ_INIT(name,size)   static FBUF name##_fbqbuf[(size)];     \               
+#define FBQ_INIT(name,size)   static FBUF name##_fbqbuf[(size)];     \
                               _fbq_init(&(name), (name##_fbqbuf), (size));
 
 // Deprecated. Use FBQ_INIT instead
@@ -16,44 +16,87 @@
 #include "fbuf.h"
 #include "ax25.h"
 #include "config.h"
+#include "journal.h"
 #include "gps.h"
 #include <math.h>
 
 
-#define NMEA_BUFSIZE   80
-#define NMEA_MAXTOKENS 16
-
-
-/* Defined in commands.c */
-uint8_t tokenize(char*, char*[], uint8_t, char*, bool);
-
 /* Defined in uart.c */
 Stream* uart_tx_init(uint16_t);
 Stream* uart_rx_init(uint16_t, bool);
+void uart_set_baud(uint16_t);
 
 /* Current position */
 posdata_t current_pos; 
+uint16_t course_count = 0;  
+int32_t altitude = -1;
 
 /* Local handlers */
-static void do_rmc        (uint8_t, char**, Stream*);
-static void do_gga        (uint8_t, char**, Stream*);
+static void do_rmc        (Stream*);
+static void do_gga        (void);
+static void do_pvt        (void);
 static void nmeaListener  (void); 
+static void ubx_config    (void);
+static void ubx_fallback  (void*);
+static void ubx_restore   (void);
+static void ubx_set_port  (uint16_t, uint8_t);
+static void ubx_send      (uint8_t, uint8_t, uint8_t*, uint8_t);
+static void gps_learn_ttf (void);
+static void gps_count_on  (void);
 void notify_fix   (bool);
 
-static char buf[NMEA_BUFSIZE];
 static bool monitor_pos, monitor_raw; 
-static Stream *in, *out; 
+static Stream *in, *out, *gpsout = NULL; 
 static bool is_fixed = true;
 extern uint8_t blink_length, blink_interval;
 static Cond wait_gps; 
+static uint16_t nmea_baud;
+
+/* UBX mode states */
+#define UBX_OFF  0    /* NMEA only */
+#define UBX_WAIT 1    /* Configure receiver when it is heard */
+#define UBX_CONF 2    /* Configured, waiting for first UBX message */
+#define UBX_ON   3
+#define UBX_FAIL 4    /* No UBX message. Restore NMEA output */
+
+/* UBX message classes and ids */
+#define UBX_SYNC1    0xB5
+#define UBX_SYNC2    0x62
+#define UBX_NAV      0x01
+#define UBX_NAV_PVT  0x07
+#define UBX_CFG      0x06
+#define UBX_CFG_PRT  0x00
+#define UBX_CFG_MSG  0x01
+#define UBX_CFG_RST  0x04
+#define UBX_PVT_LEN  92
+#define UBX_TIMEOUT  5
+
+static uint8_t ubx_mode = UBX_OFF;
+static bool ubx_failed = false;   /* Receiver does not support NAV-PVT */
+static Timer ubx_timer;
+
+/* Power management state */
+static bool gps_powered = false, standby = false;
+static bool ttf_pending = false; 
+static uint8_t ttf_class;                  /* 0=hot start, 1=warm start */
+static uint16_t ttf_est[2] = { GPS_FIX_TIME*4, GPS_WARM_FIX_TIME*4 };  /* 1/4 sec */
+static uint32_t on_ticks, off_ticks; 
+static uint32_t on_time = 0;               /* Seconds */
+static uint16_t n_starts = 0, n_reports = 0; 
+static uint32_t fix_ticks = 0;             /* Time of last valid position */
 
 void gps_init(Stream *outstr)
 {
     cond_init(&wait_gps); 
     monitor_pos = monitor_raw = false; 
-    uint16_t baud; 
-    GET_PARAM(GPS_BAUD, &baud);
-    in = uart_rx_init(baud, FALSE);
+    GET_PARAM(GPS_BAUD, &nmea_baud);
+    
+    /* Transmitter is only needed to configure receiver in UBX mode 
+     * or to use standby mode. 
+     */
+    if (GET_BYTE_PARAM(GPS_UBX) || GET_BYTE_PARAM(GPS_STANDBY))
+       gpsout = uart_tx_init(nmea_baud);
+    in = uart_rx_init(nmea_baud, FALSE);
     out = outstr;
     THREAD_START(nmeaListener, STACK_GPSLISTENER);
     make_output(GPSON); 
@@ -62,15 +105,77 @@ void gps_init(Stream *outstr)
 
 void gps_on()
 {
+   if (!gps_powered) {
+      /* Start measuring time to fix */
+      uint32_t now = timer_ticks(); 
+      ttf_class = (n_starts > 0 && now - off_ticks < GPS_HOT_TIME * (uint32_t) TIMER_RESOLUTION) ? 0 : 1;
+      on_ticks = now; 
+      ttf_pending = true;
+      n_starts++;
+      gps_powered = true; 
+   }
    clear_port(GPSON);
    notify_fix(false);
+   
+   if (standby) {
+      /* Wake up receiver. Any character wakes up a receiver in 
+       * NMEA standby mode. 
+       */
+      if (ubx_mode == UBX_ON) {
+         uint8_t rst[4] = { 0, 0, 0x09, 0 };     /* Controlled GNSS start */
+         ubx_send(UBX_CFG, UBX_CFG_RST, rst, sizeof(rst));
+      }
+      else
+         putstr_P(gpsout, PSTR("$PMTK000*32\r\n"));
+      standby = false;
+   }
+   else if (gpsout != NULL && GET_BYTE_PARAM(GPS_UBX) && !ubx_failed)
+      /* Receiver starts in NMEA mode at power on. Configure UBX mode
+       * when it has been heard. 
+       */
+      ubx_mode = UBX_WAIT;
+}
+
+
+
+/*************************************************************************
+ * Put receiver in standby mode using serial link, if this is 
+ * enabled. This keeps the receiver's configuration and ephemeris
+ * data. Otherwise, just turn off power. 
+ *************************************************************************/
+ 
+void gps_standby()
+{
+   if (standby)
+      return;
+   if (!GET_BYTE_PARAM(GPS_STANDBY) || gpsout == NULL) {
+      gps_off();
+      return;
+   }
+   gps_count_on(); 
+   if (ubx_mode == UBX_ON) {
+      uint8_t rst[4] = { 0, 0, 0x08, 0 };        /* Controlled GNSS stop */
+      ubx_send(UBX_CFG, UBX_CFG_RST, rst, sizeof(rst));
+   }
+   else 
+      putstr_P(gpsout, PSTR("$PMTK161,0*28\r\n"));
+   standby = true;
+   BLINK_NORMAL
 }
 
 
+
 void gps_off()
 { 
+   gps_count_on();
+   standby = false;
    set_port(GPSON);
    BLINK_NORMAL   
+   if (ubx_mode != UBX_OFF) {
+      timer_cancel(&ubx_timer);
+      uart_set_baud(nmea_baud);
+      ubx_mode = UBX_OFF;
+   }
 }
 
 
@@ -93,90 +198,835 @@ static const double EARTH_RADIUS_IN_METERS = 6372797.560856;
  *   http://en.wikipedia.org/wiki/Law_of_haversines
  */
  
+/* Position fields are in 1e-7 degrees */
+#define E7_TO_RAD (DEG_TO_RAD / 1e7)
+ 
 static double arcInRadians(posdata_t *from, posdata_t *to)
 {
-      double latitudeArc  = (from->latitude - to->latitude) * DEG_TO_RAD;
-      double longitudeArc = (from->longitude - to->longitude) * DEG_TO_RAD;
+      double latitudeArc  = (from->latitude - to->latitude) * E7_TO_RAD;
+      double longitudeArc = (from->longitude - to->longitude) * E7_TO_RAD;
       double latitudeH = sin(latitudeArc * 0.5);
       latitudeH *= latitudeH;
       double lontitudeH = sin(longitudeArc * 0.5);
       lontitudeH *= lontitudeH;
-      double tmp = cos(from->latitude * DEG_TO_RAD) * cos(to->latitude * DEG_TO_RAD);
+      double tmp = cos(from->latitude * E7_TO_RAD) * cos(to->latitude * E7_TO_RAD);
       return 2.0 * asin(sqrt(latitudeH + tmp * lontitudeH));
 }
 
 
 
-uint32_t gps_distance(posdata_t *from, posdata_t *to)
+static uint32_t exact_distance(posdata_t *from, posdata_t *to)
 {
     return (uint32_t) round(EARTH_RADIUS_IN_METERS * arcInRadians(from, to));
 }
 
 
-uint16_t gps_bearing(posdata_t *from, posdata_t *to)
+static uint16_t exact_bearing(posdata_t *from, posdata_t *to)
 {
-    double dLon = (from->longitude - to->longitude) * DEG_TO_RAD;
-    double toLat = to->latitude * DEG_TO_RAD;
-    double fromLat = from->latitude * DEG_TO_RAD;
+    double dLon = (from->longitude - to->longitude) * E7_TO_RAD;
+    double toLat = to->latitude * E7_TO_RAD;
+    double fromLat = from->latitude * E7_TO_RAD;
     if (dLon == 0 && toLat==fromLat)
        return -1;
-    double y = sin(dLon) * cos(from->latitude * DEG_TO_RAD);
+    double y = sin(dLon) * cos(fromLat);
     double x = cos(toLat) * sin(fromLat) - sin(toLat) * cos(fromLat) * cos(dLon);
-    uint16_t brng = (uint16_t) round(atan2(y, x) / DEG_TO_RAD);
+    int16_t brng = (int16_t) round(atan2(y, x) / DEG_TO_RAD);
     return (brng + 180) % 360; 
 }
 
 
 
+/*************************************************************************
+ * Fast distance and bearing for short distances (what the tracker 
+ * normally compares). Equirectangular approximation: Longitude 
+ * difference is scaled by cos(latitude), using a table and a cached 
+ * value for the latitude band. Bearing uses a table-based atan2. 
+ * The exact (haversine) formulas are used for longer distances. 
+ *************************************************************************/
+
+/* Max latitude or longitude difference (1e-7 degrees) for fast method. 
+ * This keeps the squared distance in decimeters within 32 bits. 
+ */
+#define FAST_LIMIT 250000L
+
+/* cos(x) for x = 0..90 degrees (1.15 fixed point) */
+static const uint16_t cos_tab[91] PROGMEM = {
+    32767, 32763, 32748, 32723, 32688, 32643, 32588, 32524, 32449, 32365, 
+    32270, 32166, 32052, 31928, 31795, 31651, 31499, 31336, 31164, 30983, 
+    30792, 30592, 30382, 30163, 29935, 29698, 29452, 29197, 28932, 28660, 
+    28378, 28088, 27789, 27482, 27166, 26842, 26510, 26170, 25822, 25466, 
+    25102, 24730, 24351, 23965, 23571, 23170, 22763, 22348, 21926, 21498, 
+    21063, 20622, 20174, 19720, 19261, 18795, 18324, 17847, 17364, 16877, 
+    16384, 15886, 15384, 14876, 14365, 13848, 13328, 12803, 12275, 11743, 
+    11207, 10668, 10126,  9580,  9032,  8481,  7927,  7371,  6813,  6252, 
+     5690,  5126,  4560,  3993,  3425,  2856,  2286,  1715,  1144,   572, 0 
+};
+
+/* atan(i/32) for i = 0..32 (1/10 degrees) */
+static const uint16_t atan_tab[33] PROGMEM = {
+      0,  18,  36,  54,  71,  89, 106, 123, 140, 157, 174, 190, 206, 221, 
+    236, 251, 266, 280, 294, 307, 320, 333, 345, 357, 369, 380, 391, 402, 
+    412, 422, 432, 441, 450
+};
+
+/* 1e-7 degrees to decimeters along a meridian (0.1111949 << 16) */
+#define E7_TO_DM 7287
+
+
+/*
+ * cos(latitude) in 1.15 fixed point. Latitude bands are 0.01 degrees. 
+ */
+static uint16_t cos_lat(int32_t lat)
+{
+    static uint16_t band = 0xffff, c; 
+    uint32_t a = (lat < 0 ? -lat : lat);
+    if (a / 100000 != band) {
+       band = a / 100000;
+       uint8_t deg = a / 10000000; 
+       uint16_t c0 = pgm_read_word(&cos_tab[deg]);
+       uint16_t c1 = pgm_read_word(&cos_tab[deg < 90 ? deg+1 : 90]);
+       c = c0 - (uint16_t) (((uint32_t) (c0 - c1) * (band % 100)) / 100);
+    }
+    return c;
+}
+
+
+/*
+ * North and east components (decimeters) of vector between two 
+ * positions. Return false if too far apart for the fast method. 
+ */
+static bool fast_vector(posdata_t *from, posdata_t *to, int32_t* dn, int32_t* de)
+{
+    int32_t dlat = to->latitude - from->latitude;
+    int32_t dlon = to->longitude - from->longitude;
+    if (dlat > FAST_LIMIT || dlat < -FAST_LIMIT || dlon > FAST_LIMIT || dlon < -FAST_LIMIT)
+       return false;
+    *dn = (dlat * E7_TO_DM) >> 16; 
+    *de = (((dlon * E7_TO_DM) >> 16) * (int32_t) cos_lat(from->latitude + dlat/2)) >> 15;
+    return true;
+}
+
+
+static uint32_t isqrt(uint32_t x)
+{
+    uint32_t r = 0, b = 1UL << 30;
+    while (b > x)
+       b >>= 2;
+    while (b != 0) {
+       if (x >= r + b) {
+          x -= r + b;
+          r = (r >> 1) + b;
+       }
+       else
+          r >>= 1;
+       b >>= 2;
+    }
+    return r;
+}
+
+
+/*
+ * Bearing (degrees) of vector, using atan table 
+ */
+static uint16_t fast_atan2(int32_t de, int32_t dn)
+{
+    uint32_t ae = (de < 0 ? -de : de);
+    uint32_t an = (dn < 0 ? -dn : dn);
+    uint32_t r = (ae <= an ? (ae << 13) / an : (an << 13) / ae);   /* 0..8192 */
+    uint8_t i = r >> 8;
+    uint16_t a = pgm_read_word(&atan_tab[i]);
+    if (i < 32)
+       a += ((pgm_read_word(&atan_tab[i+1]) - a) * (r & 0xff)) >> 8;
+    if (ae > an)
+       a = 900 - a;
+    a = (a + 5) / 10; 
+    if (dn < 0) 
+       a = 180 - a;
+    if (de < 0)
+       a = 360 - a;
+    return a % 360;
+}
+
+
+
+uint32_t gps_distance(posdata_t *from, posdata_t *to)
+{
+    int32_t dn, de;
+    if (!fast_vector(from, to, &dn, &de))
+       return exact_distance(from, to);
+    return (isqrt((uint32_t) (dn*dn) + (uint32_t) (de*de)) + 5) / 10;
+}
+
+
+uint16_t gps_bearing(posdata_t *from, posdata_t *to)
+{
+    int32_t dn, de;
+    if (!fast_vector(from, to, &dn, &de))
+       return exact_bearing(from, to);
+    if (dn == 0 && de == 0)
+       return -1; 
+    return fast_atan2(de, dn);
+}
+
+
+
+
+/*************************************************************************
+ * Dead reckoning. Estimate position after the given number of seconds, 
+ * assuming constant speed and course. Return the radius (meters) of the
+ * area where we can expect to be. It grows with time: 1 m/s plus 10% of
+ * the speed, since speed and course may change. 
+ *************************************************************************/
+
+/* Max distance (decimeters) to extrapolate */
+#define DR_LIMIT 60000L
+
+/* Base uncertainty of a GPS position (meters) */
+#define DR_BASE_ERROR 10
+
+
+/* cos(x) for any x (degrees) in 1.15 fixed point */
+static int16_t icos(uint16_t x)
+{
+    x %= 360; 
+    if (x <= 90) 
+       return pgm_read_word(&cos_tab[x]);
+    if (x <= 180)
+       return -pgm_read_word(&cos_tab[180-x]);
+    if (x <= 270)
+       return -pgm_read_word(&cos_tab[x-180]);
+    return pgm_read_word(&cos_tab[360-x]);
+}
+
+
+/* Move position by given north and east offsets (decimeters) */
+static void move_pos(posdata_t *pos, int32_t dn, int32_t de)
+{
+    /* 1 dm is 8.993e-7 degrees of latitude. Longitude is scaled by 
+     * cos(latitude) halfway, in two steps to stay within 32 bits. 
+     */
+    int32_t dlat = dn * 8993 / 1000;
+    int32_t dlon = de * 8993 / 1000;
+    int32_t c = cos_lat(pos->latitude + dlat/2);
+    if (c == 0)
+       c = 1;
+    pos->latitude += dlat;
+    pos->longitude += (dlon / c) * 32768 + (dlon % c) * 32768 / c;
+}
+
+
+uint16_t gps_dead_reckon(posdata_t *from, uint16_t secs, posdata_t *to)
+{
+    *to = *from;
+    to->timestamp += secs;
+    
+    /* Distance in decimeters. 1/100 knots is 0.05144 dm/s (3371 >> 16) */
+    uint32_t d = ((uint64_t) from->speed * secs * 3371) >> 16;
+    if (d > DR_LIMIT)
+       d = DR_LIMIT;
+    
+    if (from->course < 360 && d > 0) 
+       move_pos(to, ((int32_t) d * icos(from->course)) >> 15, 
+                    ((int32_t) d * icos(from->course + 270)) >> 15);
+    uint32_t r = DR_BASE_ERROR + secs + ((uint32_t) secs * from->speed) / 1944; 
+    return (r > 0xffff ? 0xffff : r);
+}
+
+
+/*************************************************************************
+ * Kalman filter with a constant velocity model, for the north and east
+ * axes separately. Position and velocity (from the receiver's speed and 
+ * course) are measured. The filtered speed and course are used by the 
+ * tracker, so that GPS jitter at low speeds does not trigger reports. 
+ *   Velocities are in 1/16 dm/s, covariances in decimeters and 
+ *   seconds, gains in 1/1024. 
+ *************************************************************************/
+
+#define KF_R      1600     /* Position measurement variance: (4 m)^2 */
+#define KF_RV     100      /* Velocity measurement variance: (1 m/s)^2 */
+#define KF_QA     25       /* Acceleration variance: (0.5 m/s^2)^2 */
+#define KF_P11    10000    /* Initial velocity variance: (10 m/s)^2 */
+#define KF_PMAX   2000000L /* Limit for covariances */
+#define KF_VMAX   32000    /* Limit for velocity (200 m/s) */
+#define KF_MAXGAP 20       /* Restart filter if no position for this long (sec) */
+
+typedef struct {
+   int32_t v; 
+   int32_t p00, p01, p11; 
+} kf_axis_t;
+
+static kf_axis_t kf_n, kf_e; 
+
+/* Filtered position */
+posdata_t filtered_pos;
+
+
+/* Predict dt seconds ahead. Return position change (dm) */
+static int32_t kf_predict(kf_axis_t *k, uint8_t dt)
+{
+    int32_t q = (int32_t) KF_QA * dt * dt;
+    k->p00 += dt * (2 * k->p01 + dt * k->p11) + q * dt * dt / 4;
+    k->p01 += dt * k->p11 + q * dt / 2;
+    k->p11 += q;
+    k->p00 = min(k->p00, KF_PMAX);
+    k->p01 = min(k->p01, KF_PMAX/2);
+    k->p11 = min(k->p11, KF_PMAX/2);
+    return k->v * dt / 16;
+}
+
+
+/* Correct with measured offset y (dm) from predicted position. Return position change (dm) */
+static int32_t kf_correct(kf_axis_t *k, int32_t y)
+{
+    int32_t s = k->p00 + KF_R;
+    int32_t k0 = k->p00 * 1024 / s;
+    int32_t k1 = k->p01 * 1024 / s;
+    
+    k->v += (k1 * y) >> 6;
+    if (k->v > KF_VMAX) k->v = KF_VMAX;
+    if (k->v < -KF_VMAX) k->v = -KF_VMAX;
+    k->p11 -= (k1 * k->p01) >> 10;
+    k->p01 -= (k0 * k->p01) >> 10;
+    k->p00 -= (k0 * k->p00) >> 10;
+    return (k0 * y) >> 10;
+}
+
+
+/* Correct with measured velocity vm (1/16 dm/s). Return position change (dm) */
+static int32_t kf_correct_v(kf_axis_t *k, int32_t vm)
+{
+    int32_t y = vm - k->v;
+    int32_t s = k->p11 + KF_RV;
+    int32_t k0 = k->p01 * 1024 / s;
+    int32_t k1 = k->p11 * 1024 / s;
+    
+    k->v += (k1 * y) >> 10;
+    k->p00 -= (k0 * k->p01) >> 10;
+    k->p01 -= (k1 * k->p01) >> 10;
+    k->p11 -= (k1 * k->p11) >> 10;
+    return (k0 * y) >> 14;
+}
+
+
+/* Measured velocity (1/16 dm/s) north and east */
+static void kf_measured_v(posdata_t *m, int32_t *vn, int32_t *ve)
+{
+    int32_t v = (int32_t) m->speed * 823 / 1000; 
+    *vn = (v * icos(m->course)) >> 15;
+    *ve = (v * icos(m->course + 270)) >> 15;
+}
+
+
+static void kf_init(kf_axis_t *k, int32_t v)
+{
+    k->v = v;
+    k->p00 = KF_R;
+    k->p01 = 0;
+    k->p11 = KF_P11;
+}
+
+
+static void kf_update(posdata_t *m)
+{
+    int32_t dn, de;
+    uint32_t dt = m->timestamp - filtered_pos.timestamp;
+    
+    if (filtered_pos.timestamp == 0 || m->timestamp <= filtered_pos.timestamp || dt > KF_MAXGAP) {
+       /* Start with measured position and velocity */
+       dn = de = 0;
+       if (m->course < 360)
+          kf_measured_v(m, &dn, &de);
+       filtered_pos = *m;
+       kf_init(&kf_n, dn);
+       kf_init(&kf_e, de);
+       return;
+    }
+    move_pos(&filtered_pos, kf_predict(&kf_n, dt), kf_predict(&kf_e, dt));
+    if (!fast_vector(&filtered_pos, m, &dn, &de)) {
+       filtered_pos.timestamp = 0;
+       kf_update(m);
+       return; 
+    }
+    move_pos(&filtered_pos, kf_correct(&kf_n, dn), kf_correct(&kf_e, de));
+    if (m->course < 360) {
+       kf_measured_v(m, &dn, &de);
+       move_pos(&filtered_pos, kf_correct_v(&kf_n, dn), kf_correct_v(&kf_e, de));
+    }
+    filtered_pos.timestamp = m->timestamp;
+    filtered_pos.altitude = m->altitude;
+    
+    /* Speed in 1/100 knots is 1.215 * 1/16 dm/s */
+    filtered_pos.speed = (isqrt((uint32_t) (kf_n.v * kf_n.v) + (uint32_t) (kf_e.v * kf_e.v)) * 1215) / 1000;
+    if (kf_n.v != 0 || kf_e.v != 0)
+       filtered_pos.course = fast_atan2(kf_e.v, kf_n.v);
+}
+
+
+
+/* Seconds since last valid position from GPS */
+uint16_t gps_fix_age()
+{
+    uint32_t t = (timer_ticks() - fix_ticks) / TIMER_RESOLUTION;
+    return (t > 0xffff ? 0xffff : t);
+}
+
+
+
 
 /**************************************************************************
- * Read and process NMEA sentences.
- *    Not thread safe. Use in at most one thread, use lock, or allocate
- *    buf on the stack instead. 
+ * NMEA parser. 
+ *   Sentences are parsed character by character as they arrive. The 
+ *   checksum is computed on the fly and numeric fields are converted 
+ *   directly to fixed point integers. Sentences other than RMC and GGA
+ *   are skipped as soon as the sentence type is known. 
  **************************************************************************/
+
+#define NMEA_IDLE  0
+#define NMEA_DATA  1
+#define NMEA_CSUM  2
+
+#define NMEA_OTHER 0
+#define NMEA_RMC   1
+#define NMEA_GGA   2
+
+/* Max number of decimals kept in numeric fields */
+#define NMEA_MAXFRAC 5
+
+static struct {
+   uint8_t state, type, field, pos; 
+   uint8_t csum, rcsum, ncsum; 
+   char tid[3];
+   uint32_t num;           /* Digits of field (without decimal point) */
+   uint8_t ndig, nfrac;    /* Number of digits, number of decimals */
+   bool frac, neg; 
+   char chr;               /* First non-numeric character of field */
+} nmea;
+
+/* Fields of current sentence */
+static uint32_t f_time;            /* hhmmss */
+static uint8_t  f_date;            /* Day of month */
+static char     f_status;
+static int32_t  f_lat, f_long;     /* 1e-7 degrees */
+static uint16_t f_speed, f_course; /* 1/100 knots, 1/100 degrees */
+static bool     f_fix; 
+static int32_t  f_alt;             /* 1/10 meters */
+
 bool nmea_ok = false;
+
+static void nmea_char(char);
+static void nmea_field(void);
+static void nmea_end(bool);
+static bool ubx_char(uint8_t);
+
+
+
 static void nmeaListener()
 {
-    char* argv[16];
-    uint8_t argc;
-   
+    char c;
     while (1) {
-         uint8_t checksum = 0; 
-         int c_checksum;
-                 
-         getstr(in, buf, NMEA_BUFSIZE, '\n');
-         
-         if (buf[0] != '$')
+         c = getch(in);
+         if (ubx_mode == UBX_FAIL) {
+            ubx_restore();
             continue;
-
-         
-         /* If requested, show raw NMEA packet on screen */
-         if (monitor_raw) {
-             putstr(out, buf);
-             putstr(out, "\n");
          }
          
-         /* Checksum (optional) */
-         uint8_t i;
-         for (i=1; i<NMEA_BUFSIZE && buf[i] !='*' && buf[i] != 0 ; i++) 
-            checksum ^= buf[i];
-         if (buf[i] == '*') {
-            buf[i] = 0;
-            sscanf(buf+i+1, "%X", &c_checksum);
-            if (c_checksum != checksum) 
-               continue;
-         } 
-         nmea_ok = true;
-         
-         /* Split input line into tokens */
-         argc = tokenize(buf, argv, NMEA_MAXTOKENS, ",", false);           
-         
-         /* Select command handler */    
-         if (strncmp("RMC", argv[0]+3, 3) == 0)
-             do_rmc(argc, argv, out);
-         else if (strncmp("GGA", argv[0]+3, 3) == 0)
-             do_gga(argc, argv, out);
-   }
+         /* UBX messages start with a non-ASCII character */
+         if (ubx_char(c))
+            continue;
+            
+         /* If requested, show raw NMEA packet on screen */
+         if (monitor_raw) 
+            putch(out, c);
+         nmea_char(c);
+    }
+}
+
+
+
+static void nmea_char(char c)
+{
+    if (c == '$') {
+       nmea.state = NMEA_DATA;
+       nmea.type = NMEA_OTHER;
+       nmea.csum = nmea.field = nmea.pos = 0; 
+       nmea.tid[0] = 0;
+       nmea.num = nmea.ndig = nmea.nfrac = 0;
+       nmea.frac = nmea.neg = false; 
+       nmea.chr = 0; 
+       return;
+    }
+    switch (nmea.state) {
+       case NMEA_DATA: 
+          if (c == '\r' || c == '\n') {
+             /* Checksum is optional */
+             nmea_field();
+             nmea_end(true);
+          }
+          else if (c == '*') {
+             nmea_field();
+             nmea.state = NMEA_CSUM; 
+             nmea.rcsum = nmea.ncsum = 0;
+          }
+          else {
+             nmea.csum ^= c;
+             if (c == ',') {
+                nmea_field();
+                nmea.field++; 
+                nmea.pos = 0;
+             }
+             else if (nmea.field == 0) {
+                if (nmea.pos >= 2 && nmea.pos < 5)
+                   nmea.tid[nmea.pos-2] = c;
+                nmea.pos++; 
+             }
+             else if (c >= '0' && c <= '9') {
+                if (!nmea.frac || nmea.nfrac < NMEA_MAXFRAC) {
+                   nmea.num = nmea.num * 10 + (c - '0');
+                   nmea.ndig++;
+                   if (nmea.frac)
+                      nmea.nfrac++;
+                }
+             }
+             else if (c == '.')
+                nmea.frac = true;
+             else if (c == '-')
+                nmea.neg = true;
+             else if (nmea.chr == 0)
+                nmea.chr = c;
+          }
+          break;
+          
+       case NMEA_CSUM: 
+          if (c >= '0' && c <= '9')
+             nmea.rcsum = (nmea.rcsum << 4) | (c - '0');
+          else if (c >= 'A' && c <= 'F')
+             nmea.rcsum = (nmea.rcsum << 4) | (c - 'A' + 10);
+          else {
+             nmea.state = NMEA_IDLE;
+             break;
+          }
+          if (++nmea.ncsum == 2) 
+             nmea_end(nmea.rcsum == nmea.csum);
+          break;
+    }
+}
+
+
+
+/****************************************************************
+ * Scale numeric field to given number of decimals
+ ****************************************************************/
+
+static uint32_t nmea_num(uint8_t ndec)
+{
+    uint32_t x = nmea.num;
+    uint8_t n = nmea.nfrac;
+    for (; n < ndec; n++)
+       x *= 10;
+    for (; n > ndec; n--)
+       x /= 10;
+    return x;
+}
+
+
+/****************************************************************
+ * Convert NMEA coordinate [dddmm.mmmmm] to 1e-7 degrees
+ ****************************************************************/
+
+static int32_t nmea_coord()
+{
+    uint32_t x = nmea_num(5); 
+    return (int32_t) ((x / 10000000) * 10000000 + ((x % 10000000) * 100 + 30) / 60);
+}
+
+
+
+/****************************************************************
+ * End of field. Store value if it is a field we need. 
+ ****************************************************************/
+
+static void nmea_field()
+{
+    if (nmea.field == 0) {
+       if (strncmp("RMC", nmea.tid, 3) == 0)
+          nmea.type = NMEA_RMC;
+       else if (strncmp("GGA", nmea.tid, 3) == 0)
+          nmea.type = NMEA_GGA;
+       else
+          nmea.state = NMEA_IDLE;    /* Ignore rest of sentence */
+    }
+    else if (nmea.type == NMEA_RMC) 
+       switch (nmea.field) {
+          case 1: f_time = nmea_num(0); break;
+          case 2: f_status = nmea.chr; break;
+          case 3: f_lat = nmea_coord(); break;
+          case 4: if (nmea.chr == 'S') f_lat = -f_lat; break;
+          case 5: f_long = nmea_coord(); break;
+          case 6: if (nmea.chr == 'W') f_long = -f_long; break;
+          case 7: f_speed = (nmea.ndig > 0 ? nmea_num(2) : 0); break;
+          case 8: f_course = (nmea.ndig > 0 ? nmea_num(2) : 0); break;
+          case 9: f_date = nmea_num(0) / 10000; break;
+       }
+    else if (nmea.type == NMEA_GGA) 
+       switch (nmea.field) {
+          case 6: f_fix = (nmea.num > 0); break;
+          case 9: f_alt = (nmea.neg ? -1 : 1) * (int32_t) nmea_num(1); break;
+       }
+       
+    nmea.num = nmea.ndig = nmea.nfrac = 0;
+    nmea.frac = nmea.neg = false; 
+    nmea.chr = 0; 
+}
+
+
+
+/****************************************************************
+ * End of sentence. Process it if checksum is ok. 
+ ****************************************************************/
+
+static void nmea_end(bool valid)
+{
+    uint8_t type = nmea.type;
+    nmea.state = NMEA_IDLE;
+    if (!valid || type == NMEA_OTHER || nmea.field < 9)
+       return;
+    nmea_ok = true;
+    if (ubx_mode == UBX_WAIT)
+       ubx_config();
+    if (type == NMEA_RMC)
+       do_rmc(out);
+    else
+       do_gga();
+}
+
+
+
+/**************************************************************************
+ * UBX binary protocol (u-blox receivers). 
+ *   If enabled, the receiver is configured to send NAV-PVT messages 
+ *   only, at a higher baud rate. If no valid NAV-PVT message is received 
+ *   within UBX_TIMEOUT seconds, the receiver is set back to NMEA output, 
+ *   and UBX mode is not tried again. 
+ **************************************************************************/
+
+#define UBX_IDLE     0
+#define UBX_SYNC     1
+#define UBX_CLASS    2
+#define UBX_ID       3
+#define UBX_LEN1     4
+#define UBX_LEN2     5
+#define UBX_PAYLOAD  6
+#define UBX_CKA      7
+#define UBX_CKB      8
+
+static struct {
+   uint8_t state, cls, id; 
+   uint8_t len, pos; 
+   uint8_t ck_a, ck_b; 
+   uint8_t buf[UBX_PVT_LEN];
+} ubx;
+
+
+
+/****************************************************************
+ * Send UBX message (with checksum) to receiver
+ ****************************************************************/
+
+static void ubx_send(uint8_t cls, uint8_t id, uint8_t* payload, uint8_t len)
+{
+    uint8_t hdr[4] = {cls, id, len, 0};
+    uint8_t ck_a = 0, ck_b = 0, i;
+    
+    putch(gpsout, UBX_SYNC1);
+    putch(gpsout, UBX_SYNC2);
+    for (i=0; i<4+len; i++) {
+       uint8_t c = (i < 4 ? hdr[i] : payload[i-4]);
+       ck_a += c;
+       ck_b += ck_a;
+       putch(gpsout, c);
+    }
+    putch(gpsout, ck_a);
+    putch(gpsout, ck_b);
+}
+
+
+
+/****************************************************************
+ * Set baud rate and output protocols (UBX=1, NMEA=2) of UART1 
+ * of receiver (input is UBX+NMEA), and then change our baud rate. 
+ ****************************************************************/
+
+static void ubx_set_port(uint16_t baud, uint8_t out_proto)
+{
+    uint8_t prt[20] = { 
+       1, 0, 0, 0,                  /* Port id, reserved, txReady */
+       0xd0, 0x08, 0, 0,            /* Mode: 8N1 */
+       baud & 0xff, baud >> 8, 0, 0,  
+       0x03, 0, out_proto, 0,       /* In: UBX+NMEA */
+       0, 0, 0, 0 };
+       
+    ubx_send(UBX_CFG, UBX_CFG_PRT, prt, sizeof(prt));
+    
+    /* Let transmission complete before changing baud rate */
+    sleep(25);
+    uart_set_baud(baud);
+}
+
+
+
+/****************************************************************
+ * Enable NAV-PVT on UART1 of receiver, and set it to UBX output 
+ * only at GPS_UBX_BAUD.
+ ****************************************************************/
+
+static void ubx_config()
+{
+    uint16_t baud;
+    GET_PARAM(GPS_UBX_BAUD, &baud);
+    uint8_t msg[3] = { UBX_NAV, UBX_NAV_PVT, 1 };
+       
+    ubx_send(UBX_CFG, UBX_CFG_MSG, msg, sizeof(msg));
+    ubx_set_port(baud, 0x01);
+    ubx_mode = UBX_CONF;
+    timer_set(&ubx_timer, UBX_TIMEOUT * TIMER_RESOLUTION);
+    timer_callback(&ubx_timer, ubx_fallback, NULL);
+}
+
+
+
+/****************************************************************
+ * Timer callback: Receiver did not respond to UBX configuration. 
+ * It may have accepted CFG-PRT but not support NAV-PVT (u-blox 6), 
+ * and is then silent. This runs in interrupt context, so just 
+ * wake up the listener thread to restore NMEA output. 
+ ****************************************************************/
+
+static void ubx_fallback(void* x)
+{
+    if (ubx_mode == UBX_CONF) {
+       ubx_mode = UBX_FAIL;
+       stream_put_nb(in, 0);
+    }
+}
+
+
+
+/****************************************************************
+ * Set receiver back to NMEA output at the NMEA baud rate. 
+ * CFG-PRT is sent at the UBX baud rate, which the receiver 
+ * uses if it accepted the configuration. 
+ ****************************************************************/
+
+static void ubx_restore()
+{
+    ubx_set_port(nmea_baud, 0x02);
+    ubx_mode = UBX_OFF;
+    ubx_failed = true;
+}
+
+
+
+/****************************************************************
+ * Parse UBX message character by character. Return false if
+ * character is not part of a UBX message. 
+ ****************************************************************/
+
+static bool ubx_char(uint8_t c)
+{
+    switch (ubx.state) {
+       case UBX_IDLE: 
+          if (c != UBX_SYNC1)
+             return false;
+          ubx.state = UBX_SYNC; 
+          return true;
+          
+       case UBX_SYNC: 
+          ubx.state = (c == UBX_SYNC2 ? UBX_CLASS : UBX_IDLE);
+          ubx.ck_a = ubx.ck_b = 0;
+          return true;
+          
+       case UBX_CKA: 
+          ubx.state = (c == ubx.ck_a ? UBX_CKB : UBX_IDLE);
+          return true;
+          
+       case UBX_CKB: 
+          ubx.state = UBX_IDLE;
+          if (c == ubx.ck_b && ubx.cls == UBX_NAV && ubx.id == UBX_NAV_PVT && ubx.len == UBX_PVT_LEN)
+             do_pvt();
+          return true;
+    }
+    
+    /* Class, id, length and payload are included in checksum */
+    ubx.ck_a += c;
+    ubx.ck_b += ubx.ck_a;
+    switch (ubx.state) {
+       case UBX_CLASS: 
+          ubx.cls = c;
+          ubx.state = UBX_ID; 
+          break;
+       case UBX_ID: 
+          ubx.id = c; 
+          ubx.state = UBX_LEN1; 
+          break;
+       case UBX_LEN1: 
+          ubx.len = c; 
+          ubx.state = UBX_LEN2; 
+          break;
+       case UBX_LEN2: 
+          /* Messages longer than NAV-PVT are not used */
+          ubx.pos = 0;
+          if (c != 0 || ubx.len > UBX_PVT_LEN)
+             ubx.state = UBX_IDLE;
+          else 
+             ubx.state = (ubx.len > 0 ? UBX_PAYLOAD : UBX_CKA);
+          break;
+       case UBX_PAYLOAD: 
+          ubx.buf[ubx.pos] = c;
+          if (++ubx.pos == ubx.len)
+             ubx.state = UBX_CKA;
+          break;
+    }
+    return true;
+}
+
+
+/* Little endian 32 bit field of UBX payload */
+static int32_t ubx_i32(uint8_t i)
+{
+    return (int32_t) ((uint32_t) ubx.buf[i] | ((uint32_t) ubx.buf[i+1] << 8) 
+             | ((uint32_t) ubx.buf[i+2] << 16) | ((uint32_t) ubx.buf[i+3] << 24));
+}
+
+
+
+/****************************************************************
+ * Handle NAV-PVT message. Fields are converted to the same
+ * units as RMC and GGA fields. 
+ ****************************************************************/
+
+static void do_pvt()
+{
+    uint8_t fix = ubx.buf[20];
+    if (ubx_mode == UBX_CONF) {
+       timer_cancel(&ubx_timer);
+       ubx_mode = UBX_ON;
+    }
+    nmea_ok = true;
+    
+    /* Valid fix if gnssFixOK flag is set and fix type is 2D or 3D */
+    f_status = ((ubx.buf[21] & 0x01) && (fix == 2 || fix == 3) ? 'A' : 'V');
+    f_time = ubx.buf[8] * 10000L + ubx.buf[9] * 100 + ubx.buf[10];
+    f_date = ubx.buf[7];
+    f_long = ubx_i32(24);
+    f_lat = ubx_i32(28);
+    
+    /* Ground speed mm/s -> 1/100 knots, heading 1e-5 -> 1e-2 degrees */
+    f_speed = (uint16_t) ((ubx_i32(60) * 1944L + 5000) / 10000);
+    f_course = (uint16_t) (ubx_i32(64) / 1000);
+    
+    /* Height above mean sea level mm -> 1/10 meters */
+    altitude = (fix == 3 ? ubx_i32(36) / 100 : -1);
+    do_rmc(out);
 }
 
 
@@ -198,42 +1048,15 @@ void gps_mon_off(void)
 
     
    
-/****************************************************************
- * Convert position NMEA fields to float (degrees)
- ****************************************************************/
-
-static void str2coord(const uint8_t ndeg, const char* str, float* coord)
+/* Format position field (1e-7 degrees) as degrees with 5 decimals */
+char* deg2str(char* buf, int32_t x)
 {
-    float minutes;
-    char dstring[ndeg+1];
-
-    /* Format [ddmm.mmmmm] */
-    strncpy(dstring, str, ndeg);
-    dstring[ndeg] = 0;
-    
-    sscanf(dstring, "%f", coord);      /* Degrees */
-    sscanf(str+ndeg, "%f", &minutes);  /* Minutes */
-    *coord += (minutes / 60);
-}
-
-
-
-/*****************************************************************
- * Convert date/time NMEA fields to 32 bit integer (timestamp)
- *****************************************************************/
- 
-static void nmea2time( timestamp_t* t, const char* timestr, const char* datestr)
-{
-    uint16_t hour, min, sec;
-    uint16_t date, month, year;
-    sscanf(timestr, "%2u%2u%2u", &hour, &min, &sec);
-    sscanf(datestr, "%2u%2u%2u", &date, &month, &year);
-    *t = (uint32_t) 
-         ((uint32_t) date-1) * 86400 +  ((uint32_t)hour) * 3600 + ((uint32_t)min) * 60 + sec;
+    uint32_t a = (x < 0 ? -x : x);
+    sprintf_P(buf, PSTR("%s%lu.%05lu"), (x < 0 ? "-" : ""), a / 10000000, (a % 10000000) / 100);
+    return buf;
 }
 
 
-
 char* time2str(char* buf, timestamp_t time)
 {
     sprintf(buf, "%2u:%2u:%2u", 
@@ -254,6 +1077,8 @@ void notify_fix(bool lock)
    else {
        if (!is_fixed) {
           notifyAll(&wait_gps);
+          if (ttf_pending)
+             gps_learn_ttf();
        }     
        BLINK_NORMAL
    }
@@ -261,8 +1086,75 @@ void notify_fix(bool lock)
 }
 
 
+/****************************************************************
+ * GPS power management. 
+ *   Time to fix after power on is measured, and a running estimate 
+ *   is kept for hot starts (short off periods) and warm starts, to 
+ *   let the tracker turn on the GPS just in time for the next report. 
+ *   Receiver on-time is counted for energy statistics. 
+ ****************************************************************/
+
+static void gps_learn_ttf()
+{
+    uint32_t t = (timer_ticks() - on_ticks) * 4 / TIMER_RESOLUTION;
+    uint16_t *est = &ttf_est[ttf_class];
+    if (t > 0x3fff)
+       t = 0x3fff;
+       
+    /* Increase fast, decrease slowly */
+    if (t > *est)
+       *est = (*est + t + 1) / 2;
+    else
+       *est -= (*est - t) / 8;
+    ttf_pending = false;
+}
+
+
+/* Receiver is turned off or put in standby */
+static void gps_count_on()
+{
+    if (!gps_powered)
+       return;
+    off_ticks = timer_ticks();
+    on_time += (off_ticks - on_ticks) / TIMER_RESOLUTION;
+    ttf_pending = false;
+    gps_powered = false; 
+}
+
+
+/* Expected time (seconds) to get a fix after GPS has been off for the given time */
+uint16_t gps_fix_time(uint16_t off)
+{
+    uint16_t est = ttf_est[off < GPS_HOT_TIME ? 0 : 1];
+    est = (est + est/4) / 4 + 1;           /* Add 25% margin */
+    return (est > GPS_FIX_TIME ? est : GPS_FIX_TIME);
+}
+
+
+void gps_count_report()
+   { n_reports++; }
+   
+
+void gps_stats(Stream* out)
+{
+    char buf[64];
+    uint32_t t = on_time;
+    if (gps_powered)
+       t += (timer_ticks() - on_ticks) / TIMER_RESOLUTION;
+    sprintf_P(buf, PSTR("Power-ups: %u, reports: %u, on-time: %lu sec\r\n"), n_starts, n_reports, t);
+    putstr(out, buf);
+    sprintf_P(buf, PSTR("Time to fix: hot %u sec, warm %u sec\r\n"), 
+       (ttf_est[0] + 2) / 4, (ttf_est[1] + 2) / 4);
+    putstr(out, buf);
+    sprintf_P(buf, PSTR("Energy per report: %lu mAs\r\n"), 
+       t * GPS_CURRENT / (n_reports > 0 ? n_reports : 1));
+    putstr(out, buf);
+}
+
+
+
 bool gps_is_fixed()
-   { return is_fixed && GET_BYTE_PARAM(TRACKER_ON); }
+   { return is_fixed && GET_STATE(TRACKER_ON); }
    
   
 /* Return true if we waited */   
@@ -284,9 +1176,6 @@ bool gps_wait_fix(uint16_t timeout)
 bool gps_hasWaiters()
    { return hasWaiters(&wait_gps); }
    
-   
-uint16_t course_count = 0;  
-float altitude = -1;
        
        
        
@@ -294,15 +1183,12 @@ float altitude = -1;
  * Handle RMC line
  ****************************************************************/
 
-static void do_rmc(uint8_t argc, char** argv, Stream *out)
+static void do_rmc(Stream *out)
 {
     static uint8_t lock_cnt = 4;
     
-    char buf[95], tbuf[9];
-    if (argc != 13)                 /* Ignore if wrong format */
-       return;
-
-    if (*argv[2] != 'A') { 
+    char buf[100], tbuf[9], latbuf[14], longbuf[14];
+    if (f_status != 'A') { 
        notify_fix(false);          /* Ignore if receiver not in lock */
        lock_cnt = 4;
        return;
@@ -315,41 +1201,26 @@ static void do_rmc(uint8_t argc, char** argv, Stream *out)
       
     lock_cnt = 1;
     notify_fix(true);
+    fix_ticks = timer_ticks();
        
-    /* get timestamp */
-    nmea2time(&current_pos.timestamp, argv[1], argv[9]);
+    /* timestamp: seconds since first day of month */
+    current_pos.timestamp = 
+         ((uint32_t) f_date-1) * 86400 + (f_time / 10000) * 3600 
+            + ((f_time / 100) % 100) * 60 + f_time % 100;
    
-    /* get latitude [ddmm.mmmmm] */
-    str2coord(2, argv[3], &current_pos.latitude);  
-    if (*argv[4] == 'S')
-        current_pos.latitude = -current_pos.latitude;
-        
-     /* get longitude [dddmm.mmmmm] */
-    str2coord(3, argv[5], &current_pos.longitude);  
-    if (*argv[6] == 'W')
-        current_pos.longitude = -current_pos.longitude;
-    
-    /* get speed [nnn.nn] */
-    if (*argv[7] != '\0')
-       sscanf(argv[7], "%f", &current_pos.speed);
-    else
-       current_pos.speed = 0;
-       
-    /* get course [nnn.nn] */
-    if (*argv[8] != '\0') {
-       float x;
-       sscanf(argv[8], "%f", &x);
-       current_pos.course = (uint16_t) x+0.5;
-    }
-    else
-       current_pos.course = 0;
+    current_pos.latitude = f_lat;
+    current_pos.longitude = f_long;
+    current_pos.speed = f_speed;
+    current_pos.course = (f_course + 50) / 100;
     current_pos.altitude = altitude;
+    kf_update(&current_pos);
            
     /* If requested, show position on screen */    
     if (monitor_pos) {
-        sprintf_P(buf, PSTR("TIME: %s, POS: lat=%f, long=%f, SPEED: %f km/h, COURSE: %u deg\r\n"), 
-          time2str(tbuf, current_pos.timestamp), current_pos.latitude, current_pos.longitude, 
-          current_pos.speed*KNOTS2KMH, current_pos.course);
+        sprintf_P(buf, PSTR("TIME: %s, POS: lat=%s, long=%s, SPEED: %u km/h, COURSE: %u deg\r\n"), 
+          time2str(tbuf, current_pos.timestamp), deg2str(latbuf, current_pos.latitude), 
+          deg2str(longbuf, current_pos.longitude), 
+          (uint16_t) (((uint32_t) current_pos.speed * 1853 + 50000) / 100000), current_pos.course);
         putstr(out, buf);
     }
 }
@@ -359,10 +1230,10 @@ static void do_rmc(uint8_t argc, char** argv, Stream *out)
  * Get altitude from GGA line
  *******************************************/
 
-static void do_gga(uint8_t argc, char** argv, Stream *out)
+static void do_gga()
 {
-    if (argc == 15 && *argv[6] > '0')
-       sscanf(argv[9], "%f", &altitude);
+    if (f_fix)
+       altitude = f_alt;
     else
        altitude = -1; 
 }
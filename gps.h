@@ -11,11 +11,12 @@
 /* Timestamp: Seconds since first day of month 00:00 */
 typedef uint32_t timestamp_t; 
 
-/* Position report */
+/* Position report (fixed point) */
 typedef struct _PosData {    
-    float latitude;
-    float longitude;
-    float  speed, altitude;
+    int32_t latitude;         /* 1e-7 degrees */
+    int32_t longitude;        /* 1e-7 degrees */
+    uint16_t speed;           /* 1/100 knots */
+    int32_t altitude;         /* 1/10 meters, negative if unknown */
     uint16_t course;
     timestamp_t timestamp;
 } posdata_t;
@@ -25,17 +26,25 @@ typedef struct _PosData {
 /* API */
 
 extern posdata_t current_pos;
+extern posdata_t filtered_pos;
 void  gps_init (Stream*);
 uint32_t gps_distance(posdata_t*, posdata_t*);
 uint16_t gps_bearing(posdata_t *from, posdata_t *to);
+uint16_t gps_dead_reckon(posdata_t *from, uint16_t secs, posdata_t *to);
+uint16_t gps_fix_age(void);
 void  gps_mon_pos (void);
 void  gps_mon_raw (void);
 void  gps_mon_off (void);
 bool  gps_is_fixed (void);
 bool  gps_wait_fix (uint16_t);
 char* time2str (char*, timestamp_t);
+char* deg2str (char*, int32_t);
 void gps_on(void);
 void gps_off(void);
+void gps_standby(void);
+uint16_t gps_fix_time(uint16_t);
+void gps_count_report(void);
+void gps_stats(Stream*);
 bool gps_hasWaiters(void);
 
 #endif
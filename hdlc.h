@@ -8,6 +8,15 @@
 #define MAX_HDLC_FRAME_SIZE 289 // including FCS field
 
 
+/* Transmitter statistics (airtime accounting) */
+typedef struct {
+    uint16_t tx, keyups;          /* Transmissions and PTT key-ups */
+    uint32_t frames;
+    uint32_t payload, overhead;   /* Bytes. Overhead is TXDELAY, TXTAIL and separator flags */
+    uint32_t ptt_ticks;           /* Total PTT time */
+} txstat_t;
+
+
 fbq_t* hdlc_init_decoder (stream_t *);
 fbq_t* hdlc_init_encoder (stream_t *);
 
@@ -17,9 +26,16 @@ void hdlc_test_on(uint8_t);
 void hdlc_test_off(void);
 void hdlc_wait_idle(void);
 bool hdlc_enc_packets_waiting(void);
+void hdlc_get_txstat(txstat_t*);
+void hdlc_show_txstat(Stream*);
 
 /* Packet monitoring (defined in monitor.c) */
 void mon_init(stream_t*);
 void mon_activate(bool);
 
+/* KISS mode (defined in kiss.c) */
+void kiss_init(stream_t*, stream_t*);
+void kiss_activate(bool);
+bool kiss_is_on(void);
+
 #endif /* __HDLC_H__ */
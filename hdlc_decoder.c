@@ -10,15 +10,21 @@
 #include "ui.h"
 #include "config.h"
 #include "ax25.h"
+#include "chanstat.h"
 
 
 static stream_t *stream;
 static fbuf_t fbuf;
 static fbq_t* mqueue[3];
-static bool monitor = false;
 
 static void hdlc_decode (void);
 static bool crc_match(FBUF*, uint8_t);
+static void dupe_hash(uint8_t, uint16_t);
+
+/* Duplicate check hash of frame being received */
+static uint16_t hash;
+static uint8_t hstart;
+static uint8_t hdelay[2];
 
 
    
@@ -117,6 +123,8 @@ static void hdlc_decode ()
   
    fbuf_release (&fbuf); // In case we had an abort or checksum
    fbuf_new(&fbuf);      // mismatch on the previous frame
+   hash = 0xFFFF;
+   hstart = 0;
    do {
       if (length > MAX_HDLC_FRAME_SIZE) 
          goto flag_sync; // Lost termination flag or only receiving noise?
@@ -139,18 +147,21 @@ static void hdlc_decode ()
          }
       }
       fbuf_putChar(&fbuf, octet);
+      dupe_hash(octet, length);
       length++;
    } while (bit != HDLC_FLAG);
 
 
    if (crc_match(&fbuf, length)) 
    {     
+      chanstat_frame(length-2);
       /* Send packets to subscribers, if any. 
        * Note that every receiver should release the buffers after use. 
        * Note also that receiver queues should not share the fbuf, use newRef to create a new reference
        */
       fbuf_removeLast(&fbuf);
       fbuf_removeLast(&fbuf);
+      fbuf.hash = hash;
       if (mqueue[0] || mqueue[1] || mqueue[2]) { 
          if (mqueue[0]) fbq_put( mqueue[0], fbuf);               /* Monitor */
          if (mqueue[1]) fbq_put( mqueue[1], fbuf_newRef(&fbuf)); /* Digipeater */
@@ -166,6 +177,44 @@ static void hdlc_decode ()
 
 
 
+/***********************************************************
+ * Update the duplicate check hash with the octet at position
+ * pos of the frame being received. The hash covers the
+ * destination and source callsigns and SSIDs, and the
+ * information field. The digipeater path, the control and PID
+ * fields and the FCS are skipped. Since we don't know where the
+ * frame ends, the last two octets are held back (they are the
+ * FCS when the frame is complete).
+ ***********************************************************/
+
+static void dupe_hash(uint8_t c, uint16_t pos)
+{
+   if (pos < 14) {
+      /* Destination and source address */
+      if (pos % 7 == 6) {
+         hash = _crc_ccitt_update(hash, (c & 0x1E) >> 1);
+         if (pos == 13 && (c & FLAG_LAST))
+            hstart = 16;
+      }
+      else
+         hash = _crc_ccitt_update(hash, c);
+   }
+   else if (hstart == 0) {
+      /* Digipeater path */
+      if (pos % 7 == 6 && (c & FLAG_LAST))
+         hstart = pos + 3;
+   }
+   else if (pos >= hstart) {
+      /* Information field */
+      if (pos >= hstart + 2)
+         hash = _crc_ccitt_update(hash, hdelay[0]);
+      hdelay[0] = hdelay[1];
+      hdelay[1] = c;
+   }
+}
+
+
+
 /***********************************************************
  * CRC check
  ***********************************************************/
@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include "fbuf.h"
 #include "hdlc.h"
 #include "kernel/kernel.h"
@@ -17,7 +18,10 @@
 #include "config.h"
 #include <util/crc16.h>
 #include "transceiver.h"
+#include "afsk.h"
+#include "chanstat.h"
 #include "ui.h"
+#include <stdio.h>
 		          
 
 
@@ -33,15 +37,17 @@ static uint8_t testbyte;
 #define BUFFER_EMPTY (fbuf_eof(&buffer))            
 
 
-/* FIXME: Those should be parameters stored in EEPROM ! */
-#define PERSISTENCE 100
-#define SLOTTIME    50
+/* Lowest persistence used by adaptive CSMA */
+#define PERSISTENCE_MIN 32
+
+static txstat_t txstat;
 
 static void hdlc_txencoder(void);
 static void hdlc_testsignal(void);
 static void hdlc_encode_frames(void);
 static void hdlc_encode_byte(uint8_t, bool);
 static void wait_channel_ready(void);
+static void csma_params(uint8_t*, uint8_t*);
 static bool hdlc_idle = true;
 static Cond hdlc_idle_sig;
 static fbq_t* _enc_queue;
@@ -76,6 +82,75 @@ bool hdlc_enc_packets_waiting()
 
 
 
+/**************************************************************
+ * Airtime accounting. Frame and byte counts are updated by
+ * the encoder, PTT time is measured by the modulator. 
+ **************************************************************/
+
+void hdlc_get_txstat(txstat_t* s)
+{
+    *s = txstat;
+    s->keyups = afsk_ptt_count();
+    s->ptt_ticks = afsk_ptt_ticks();
+}
+
+
+/* Output power in uW for 0..9 dBm. Other powers are scaled by decades */
+static const uint16_t dbm_tab[10] PROGMEM = {
+   1000, 1259, 1585, 1995, 2512, 3162, 3981, 5012, 6310, 7943 };
+
+static uint32_t dbm2uw(int8_t dbm)
+{
+    uint32_t uw;
+    uint16_t div = 1;
+    while (dbm < 0) 
+       { dbm += 10; div *= 10; }
+    uw = pgm_read_word(&dbm_tab[dbm % 10]);
+    for (; dbm >= 10; dbm -= 10)
+       uw *= 10;
+    return uw / div;
+}
+
+
+
+void hdlc_show_txstat(Stream* out)
+{
+    char buf[64];
+    txstat_t s;
+    double txpower;
+    hdlc_get_txstat(&s);
+    GET_PARAM(TRX_TXPOWER, &txpower);
+    
+    uint32_t ptt = s.ptt_ticks / (TIMER_RESOLUTION / 10);           /* 1/10 sec */
+    uint32_t uptime = timer_ticks() / (TIMER_RESOLUTION * 60) + 1;  /* minutes */
+    uint32_t bytes = s.payload + s.overhead; 
+    uint32_t fpt = s.frames * 100 / (s.tx > 0 ? s.tx : 1);          /* 1/100 */
+    
+    /* Power rounded to whole dBm (the ADF7021 goes down to -16 dBm) */
+    uint32_t uw = dbm2uw((int8_t) (txpower + 20.5) - 20);
+    uint32_t rf = uw / 100 * ptt / 10000;                           /* 1/10 J */
+    
+    sprintf_P(buf, PSTR("Transmissions: %u, key-ups: %u, frames: %lu\r\n"), 
+       s.tx, s.keyups, s.frames);
+    putstr(out, buf);
+    sprintf_P(buf, PSTR("Frames per transmission: %lu.%02lu\r\n"), fpt / 100, fpt % 100);
+    putstr(out, buf);
+    sprintf_P(buf, PSTR("Bytes: payload %lu, overhead %lu (%lu%%)\r\n"), 
+       s.payload, s.overhead, s.overhead * 100 / (bytes > 0 ? bytes : 1));
+    putstr(out, buf);
+    sprintf_P(buf, PSTR("PTT time: %lu.%lu sec, %lu sec per hour\r\n"), 
+       ptt / 10, ptt % 10, ptt * 6 / uptime);
+    putstr(out, buf);
+    
+    /* RF energy from output power (TXPOWER). Charge from the fixed estimate of 
+     * the current drawn by the transmitter (TX_CURRENT), as in telemetry reports */ 
+    sprintf_P(buf, PSTR("Energy: RF %lu.%lu J, TX %lu mAs\r\n"), 
+       rf / 10, rf % 10, ptt * TX_CURRENT / 10);
+    putstr(out, buf);
+}
+
+
+
 /*******************************************************
  * Code for generating a test signal
  *******************************************************/
@@ -126,6 +201,7 @@ void hdlc_wait_idle()
 
 static void hdlc_txencoder()
 { 
+   uint8_t persistence, slottime;
    while (true)  
    {
       /* Get frame from buffer-queue when available. 
@@ -138,12 +214,13 @@ static void hdlc_txencoder()
        */
       adf7021_wait_enabled(); 
       hdlc_idle = false;
-
+      csma_params(&persistence, &slottime);
+      
       for (;;) {
         wait_channel_ready(); 
-        int r  = rand(); 
-        if (r > PERSISTENCE * 255)
-            sleep(SLOTTIME); 
+        uint8_t r = rand() & 0xff; 
+        if (r > persistence)
+            sleep(slottime); 
         else
             break;
       }
@@ -155,8 +232,39 @@ static void hdlc_txencoder()
 }
    
 
+/*******************************************************************************
+ * Persistence (in 1/256 units) and slot time (in timer ticks) for channel 
+ * access. In adaptive mode, persistence is reduced and slot time is 
+ * increased in proportion to the channel load of the last minute, to lower 
+ * the risk of collisions when the channel is busy. 
+ *******************************************************************************/
+ 
+static void csma_params(uint8_t* p, uint8_t* slot)
+{
+    uint16_t s = GET_BYTE_PARAM(SLOTTIME);
+    *p = GET_BYTE_PARAM(PERSISTENCE);
+    if (GET_BYTE_PARAM(CSMA_ADAPTIVE)) {
+       uint8_t chan_load = chanstat_busy(1);
+       *p = (uint16_t) *p * (100 - chan_load) / 100;
+       if (*p < PERSISTENCE_MIN)
+          *p = PERSISTENCE_MIN;
+       s = s * (100 + chan_load) / 100;
+    }
+    *slot = (s > 255 ? 255 : s);
+}
+
+
+
+/*******************************************************************************
+ * Wait until channel is free. If the receiver is monitoring the channel, 
+ * wait for it to signal that the carrier is gone. Otherwise poll the 
+ * signal strength. 
+ *******************************************************************************/
+
 static void wait_channel_ready()
 {
+    if (afsk_channel_wait())
+       return;
 #ifndef TARGET_USBKEY
     double sqlevel; 
     GET_PARAM(TRX_SQUELCH, &sqlevel);
@@ -185,10 +293,15 @@ static void hdlc_encode_frames()
      /* Preamble of TXDELAY flags */
      for (i=0; i<txdelay; i++)
          hdlc_encode_byte(HDLC_FLAG, true);
+     txstat.tx++;
+     txstat.overhead += txdelay + txtail;
+     
      for (i=0;i<maxfr;i++) 
      {        
         fbuf_reset(&buffer);
         crc = 0xffff;
+        txstat.frames++;
+        txstat.payload += fbuf_length(&buffer) + 2;
 
         while(!BUFFER_EMPTY)
         {
@@ -210,6 +323,7 @@ static void hdlc_encode_frames()
         
         if (!fbq_eof(&encoder_queue) && i < maxfr) {
            hdlc_encode_byte(HDLC_FLAG, true);
+           txstat.overhead++;
            buffer = fbq_get(&encoder_queue); 
         }
         else
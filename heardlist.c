@@ -1,75 +1,78 @@
 /*
- * Heard list for digipeater
+ * Heard list for digipeater.
+ *
+ * A small open-addressed hash set of 16 bit frame checksums. Each entry
+ * has an expiry time (seconds). An entry is found within HEARDLIST_PROBES
+ * slots from its home slot. Expired entries are simply treated as free
+ * slots, so no cleanup is needed. If all the probed slots are in use, the
+ * one that expires first is replaced.
  */
 
 #include "kernel/kernel.h"
+#include "kernel/timer.h"
 #include "kernel/stream.h"
 #include "defines.h"
 #include "config.h"
 #include "digipeater.h"
 
- 
+
  typedef struct _hitem {
       uint16_t val;
-      uint16_t ts; 
- } HItem; 
- 
- HItem hlist[HEARDLIST_SIZE];
- uint8_t hlist_next = 0;
- uint8_t hlist_length = 0;
- uint16_t time = 0; 
- 
- 
-/***************************************************************** 
- * Must be called periodically with a fixed and known interval
- * It goes through list and removes entries that are older than
- * HEARDLIST_MAX_AGE (in ticks)
- *****************************************************************/ 
-
- void hlist_tick()
- {
-    time++; 
-    uint8_t i = hlist_next - hlist_length; 
-    if (i<0) 
-        i = HEARDLIST_SIZE-i; 
-    
-    while (i != hlist_next) {
-       if (hlist[i].ts < time - HEARDLIST_MAX_AGE)
-          hlist_length--;
-       else
-          break;
-       i = (i+1) % HEARDLIST_SIZE;
-    }
- }
- 
- 
+      uint16_t exp;      /* Expiry time (seconds) */
+ } HItem;
+
+ static HItem hlist[HEARDLIST_SIZE];
+
+ #define HOME(x)   (((x) ^ ((x) >> 8)) & (HEARDLIST_SIZE-1))
+ #define NEXT(i)   (((i) + 1) & (HEARDLIST_SIZE-1))
+
+
+ static uint16_t now()
+    { return timer_ticks() / TIMER_RESOLUTION; }
+
+
+/*****************************************************************
+ * Return true if entry has not expired. Time wraps around, so
+ * the remaining time must be within the max age.
+ *****************************************************************/
+
+ static bool live(HItem* h, uint16_t t)
+    { return (uint16_t) (h->exp - t - 1) < HEARDLIST_MAX_AGE; }
+
+
  /**************************************************************
   * return true if x exists in list
   **************************************************************/
- 
+
  bool hlist_exists(uint16_t x)
  {
-   uint8_t i = hlist_next - hlist_length; 
-   if (i<0) 
-     i = HEARDLIST_SIZE-i; 
-   
-   while (i != hlist_next) {
-     if (hlist[i].val == x)
-        return true; 
-     i = (i+1) % HEARDLIST_SIZE;
-   } 
-   return false; 
+   uint16_t t = now();
+   uint8_t i = HOME(x), n;
+
+   for (n=0; n<HEARDLIST_PROBES; n++, i = NEXT(i))
+      if (hlist[i].val == x && live(&hlist[i], t))
+         return true;
+   return false;
  }
- 
- 
+
+
  /*************************************************
   * Add an entry to the list
   *************************************************/
+
  void hlist_add(uint16_t x)
  {
-   hlist[hlist_next].val = x; 
-   hlist[hlist_next].ts = time;
-   hlist_next = (hlist_next + 1) % HEARDLIST_SIZE; 
-   if (hlist_length < HEARDLIST_SIZE)
-     hlist_length++;
- }
\ No newline at end of file
+   uint16_t t = now();
+   uint8_t i = HOME(x), n, k = i;
+
+   for (n=0; n<HEARDLIST_PROBES; n++, i = NEXT(i)) {
+      if (!live(&hlist[i], t) || hlist[i].val == x) {
+         k = i;
+         break;
+      }
+      if ((int16_t) (hlist[i].exp - hlist[k].exp) < 0)
+         k = i;
+   }
+   hlist[k].val = x;
+   hlist[k].exp = t + HEARDLIST_MAX_AGE;
+ }
@@ -0,0 +1,166 @@
+/*
+ * Journal for runtime state that changes often (tracker on/off, 
+ * digipeater on/off, last known position). 
+ *
+ * Records are appended round-robin in a region of EEPROM that is not 
+ * used by parameters, so that writes are spread over many cells. 
+ * Each record has a sequence number, and the latest value of each key
+ * is recovered at boot. If the slot to be overwritten holds the latest
+ * value of another key, that record is copied forward first. Bytes that
+ * are unchanged are not rewritten. 
+ *
+ * Macros for configuration (defined in defines.h)
+ *    JOURNAL_START  - EEPROM address of journal region. 
+ *    JOURNAL_SLOTS  - number of records in journal (less than 256).
+ */
+
+#include "defines.h"
+#include "kernel/kernel.h"
+#include "config.h"
+#include "fbuf.h"
+#include "journal.h"
+#include <string.h>
+
+#define JREC_SIZE   7
+#define JREC_ADDR(i) ((uint8_t*) (JOURNAL_START + (uint16_t) (i) * JREC_SIZE))
+
+typedef struct {
+    uint8_t seq, key;
+    uint8_t val[4];
+    uint8_t chk;
+} jrec_t;
+
+static uint8_t jval[J_NKEYS][4];
+static uint8_t jslot[J_NKEYS];
+static uint8_t last = NILPTR;
+static uint8_t seq = 0;
+static Mutex jlock;
+
+static bool read_rec(uint8_t, jrec_t*);
+static void write_rec(uint8_t, uint8_t, const uint8_t*);
+
+
+
+static uint8_t checksum(jrec_t* r)
+{
+    register uint8_t c = 0x5a ^ r->seq ^ r->key;
+    for (uint8_t i=0; i<4; i++)
+       c ^= r->val[i];
+    return c;
+}
+
+
+
+/*************************************************************************
+ * Find the latest record and recover the latest value of each key. 
+ * Keys not found are initialised from config parameters. 
+ *************************************************************************/
+
+void journal_init()
+{
+    jrec_t r, n;
+    uint8_t i, j, k;
+    mutex_init(&jlock);
+    memset(jval, 0, sizeof(jval));
+    memset(jslot, NILPTR, sizeof(jslot));
+    jval[J_TRACKER_ON][0] = GET_BYTE_PARAM(TRACKER_ON);
+    jval[J_DIGIPEATER_ON][0] = GET_BYTE_PARAM(DIGIPEATER_ON);
+    
+    /* The latest record is the one not followed by its successor */
+    for (i=0; i<JOURNAL_SLOTS; i++)
+       if (read_rec(i, &r) && 
+             (!read_rec((i+1) % JOURNAL_SLOTS, &n) || n.seq != (uint8_t) (r.seq+1))) {
+          last = i;
+          seq = r.seq + 1;
+          break;
+       }
+    if (last == NILPTR)
+       return;
+    
+    /* Walk backwards from latest record */
+    for (j=0, i=last; j<JOURNAL_SLOTS; j++, i = (i==0 ? JOURNAL_SLOTS-1 : i-1)) 
+       if (read_rec(i, &r) && jslot[k = r.key] == NILPTR) {
+          jslot[k] = i;
+          memcpy(jval[k], r.val, 4);
+       }
+}
+
+
+
+bool journal_get(uint8_t key, void* val)
+{
+    memcpy(val, jval[key], 4);
+    return jslot[key] != NILPTR;
+}
+
+
+uint8_t journal_get_byte(uint8_t key)
+   { return jval[key][0]; }
+
+
+
+/*************************************************************************
+ * Append a new value for key to the journal if it is changed. 
+ *************************************************************************/
+
+void journal_put(uint8_t key, const void* val)
+{
+    uint8_t next, k;
+    if (jslot[key] != NILPTR && memcmp(jval[key], val, 4) == 0)
+       return;
+       
+    mutex_lock(&jlock);
+    memcpy(jval[key], val, 4);
+    for (;;) {
+       next = (last == NILPTR ? 0 : (last + 1) % JOURNAL_SLOTS);
+       for (k=0; k<J_NKEYS && (k == key || jslot[k] != next); k++)
+          ;
+       if (k == J_NKEYS)
+          break;
+       /* Slot holds latest value of another key. Move it forward */
+       write_rec(next, k, jval[k]);
+    }
+    write_rec(next, key, jval[key]);
+    mutex_unlock(&jlock);
+}
+
+
+void journal_put_byte(uint8_t key, uint8_t val)
+{
+    uint8_t v[4] = {val, 0, 0, 0};
+    journal_put(key, v);
+}
+
+
+
+static bool read_rec(uint8_t i, jrec_t* r)
+{
+    while (!eeprom_is_ready())
+       t_yield();
+    eeprom_read_block(r, JREC_ADDR(i), JREC_SIZE);
+    return (r->key < J_NKEYS && r->chk == checksum(r));
+}
+
+
+
+/*************************************************************************
+ * Write record into slot i. Only bytes that are changed are written. 
+ *************************************************************************/
+
+static void write_rec(uint8_t i, uint8_t key, const uint8_t* val)
+{
+    jrec_t r;
+    uint8_t* addr = JREC_ADDR(i);
+    r.seq = seq++;
+    r.key = key;
+    memcpy(r.val, val, 4);
+    r.chk = checksum(&r);
+    for (uint8_t j=0; j<JREC_SIZE; j++) {
+       while (!eeprom_is_ready())
+          t_yield();
+       if (eeprom_read_byte(addr+j) != ((uint8_t*) &r)[j])
+          eeprom_write_byte(addr+j, ((uint8_t*) &r)[j]);
+    }
+    jslot[key] = i;
+    last = i;
+}
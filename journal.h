@@ -0,0 +1,23 @@
+#if !defined __JOURNAL_H__
+#define __JOURNAL_H__
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+/* Keys of state items in journal. Values are 4 bytes */
+#define J_TRACKER_ON     0
+#define J_DIGIPEATER_ON  1
+#define J_LAST_LAT       2
+#define J_LAST_LONG      3
+#define J_NKEYS          4
+
+void    journal_init(void);
+bool    journal_get(uint8_t, void*);
+void    journal_put(uint8_t, const void*);
+uint8_t journal_get_byte(uint8_t);
+void    journal_put_byte(uint8_t, uint8_t);
+
+#define GET_STATE(k)     journal_get_byte(J_##k)
+#define SET_STATE(k, v)  journal_put_byte(J_##k, (v))
+
+#endif /* __JOURNAL_H__ */
@@ -317,10 +317,18 @@ void bcond_clear(BCond* c)
    { c->val = false; }
    
    
+/* 
+ * bcond_set may be called from an interrupt handler. The test and putting 
+ * the thread on the waiting queue must then be done with interrupts off, 
+ * or a set in between would be lost. Interrupts are enabled again when 
+ * switching to the next thread, since longjmp restores its status register.
+ */
 void bcond_wait(BCond* c)
-{
+{  CONTAINS_CRITICAL;
+   enter_critical();
    if (!c->val)
        wait(&(c->waiters));
+   leave_critical();
 }
 
 
@@ -11,7 +11,9 @@
 #include <setjmp.h>
 #include <stdbool.h>
 
+#if !defined NULL
 #define NULL ((void*) 0)
+#endif
 
 
 /* 
@@ -12,6 +12,9 @@
 
 /* List of running timers */
 static Timer * _timers = NULL;
+
+/* Number of ticks since startup */
+static uint32_t _ticks = 0; 
 static void timer_remove(Timer*);
 
 
@@ -70,6 +73,23 @@ void sleep(uint16_t ticks)
 
 
 
+/********************************************************************
+ * Return number of ticks since startup. Wraps around after 
+ * 497 days at 100Hz. 
+ ********************************************************************/
+ 
+uint32_t timer_ticks() 
+{
+    CONTAINS_CRITICAL;
+    uint32_t t;
+    enter_critical();
+    t = _ticks;
+    leave_critical();
+    return t;
+}
+
+
+
 /********************************************************************** 
  * This function must be called periodically (e.g. at 100Hz) from a 
  * timer interrupt handler. 
@@ -79,6 +99,7 @@ void timer_tick()
 {
     CONTAINS_CRITICAL;
     register Timer *t;
+    _ticks++;
     for (t = _timers; t != NULL;) 
     {
         enter_critical();
@@ -13,7 +13,6 @@
 #include <inttypes.h>
 #include "kernel.h"
 
-#define NULL ((void*) 0)
 
 
 /* Timer control block. An instance of this represents
@@ -36,6 +35,7 @@ typedef void (*CBfunc) (void*);
 void timer_set(Timer*, uint16_t);
 void sleep(uint16_t);
 void timer_cancel(Timer*);
+uint32_t timer_ticks(void);
 
 #define timer_callback(t, cb, arg) { (t)->cbarg = arg; (t)->callback = cb; }
 #define timer_wait(t)              { if ((t)->count != 0) wait( &(t)->kick ); }
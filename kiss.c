@@ -0,0 +1,248 @@
+/*
+ * KISS TNC mode.
+ *
+ * Received AX.25 frames are sent to the host framed with FEND/FESC, and
+ * KISS data frames from the host are put directly on the encoder queue.
+ * This runs on the USB data channel (second CDC interface), so that the 
+ * console can be used at the same time. 
+ * See http://www.ax25.net/kiss.aspx
+ *
+ * Macros for configuration (defined in defines.h)
+ *    HDLC_DECODER_QUEUE_SIZE - size (in packets) of receiving queue.
+ *    STACK_KISS              - size of stack for each of the kiss threads.
+ */
+
+#include "kernel/kernel.h"
+#include "kernel/stream.h"
+#include "kernel/timer.h"
+#include "defines.h"
+#include "config.h"
+#include "ax25.h"
+#include "hdlc.h"
+#include "afsk.h"
+#include "radio.h"
+
+
+#define FEND   0xC0
+#define FESC   0xDB
+#define TFEND  0xDC
+#define TFESC  0xDD
+
+#define KISS_DATA        0x00
+#define KISS_TXDELAY     0x01
+#define KISS_PERSISTENCE 0x02
+#define KISS_SLOTTIME    0x03
+#define KISS_TXTAIL      0x04
+#define KISS_FULLDUPLEX  0x05
+#define KISS_SETHW       0x06
+#define KISS_RETURN      0xFF
+
+/* Length of FBUF is 8 bit */
+#define KISS_MAX_FRAME   250
+
+/* KISS TXDELAY/TXTAIL are in units of 10 ms, while the parameters
+ * are in number of flags (6.67 ms at 1200 baud)
+ */
+#define KISS2FLAGS(x)    (((uint16_t) (x) * 3) / 2)
+
+
+static bool kiss_on = false;
+static bool rx_alive = false, tx_alive = false;
+static stream_t *in, *out;
+static FBQ kissq;
+
+extern fbq_t* outframes;
+
+static void kiss_rx_thread(void);
+static void kiss_tx_thread(void);
+static void kiss_put(uint8_t);
+static void kiss_command(uint8_t, uint8_t);
+static void kiss_wakeup(void);
+
+
+
+void kiss_init(stream_t* instr, stream_t* outstr)
+{
+    in = instr;
+    out = outstr;
+    FBQ_INIT(kissq, HDLC_DECODER_QUEUE_SIZE);
+}
+
+
+bool kiss_is_on()
+   { return kiss_on; }
+
+
+
+/*********************************************************************
+ * Activate KISS mode if argument is true. Deactivate if false. 
+ * It is also deactivated when the host sends a KISS return command 
+ * (FEND 0xFF FEND).
+ *
+ * The threads have static TCBs and stacks, so a new session cannot
+ * start before the threads of the previous one have terminated. 
+ *********************************************************************/
+
+void kiss_activate(bool m)
+{
+   if (m && !kiss_on) {
+      while (rx_alive || tx_alive) {
+         kiss_wakeup();
+         sleep(5);
+      }
+      kiss_on = rx_alive = tx_alive = true;
+      radio_require();
+      afsk_enable_decoder();
+      hdlc_subscribe_rx(&kissq, 2);
+      THREAD_START(kiss_rx_thread, STACK_KISS);
+      THREAD_START(kiss_tx_thread, STACK_KISS);
+   }
+   else if (!m && kiss_on) {
+      kiss_on = false;
+      hdlc_subscribe_rx(NULL, 2);
+      kiss_wakeup();
+      afsk_disable_decoder();
+      radio_release();
+   }
+}
+
+
+
+/*********************************************************************
+ * Wake up threads to let them terminate. The tx thread may be 
+ * blocked on input from host. If the input buffer is full, it is not, 
+ * and putting FEND fails. The rx thread is only signalled if its queue 
+ * is empty, since putting a frame would block when it is full. 
+ *********************************************************************/
+
+static void kiss_wakeup()
+{
+   if (rx_alive && fbq_eof(&kissq))
+      fbq_signal(&kissq);
+   stream_put_nb(in, FEND);
+}
+
+
+
+/*********************************************************************
+ * Decode KISS frames from host. 
+ *********************************************************************/
+
+static void kiss_tx_thread()
+{
+    FBUF frame;
+    uint8_t c, cmd = 0;
+    bool esc = false, start = true;
+
+    fbuf_new(&frame);
+    while (kiss_on)
+    {
+       c = getch(in);
+       if (c == FEND) {
+          if (!start && cmd == KISS_DATA && fbuf_length(&frame) >= AX25_HDR_LEN(0))
+             fbq_put(outframes, frame);
+          else {
+             fbuf_release(&frame);
+             if (!start && cmd == KISS_RETURN)
+                kiss_activate(false);
+          }
+          fbuf_new(&frame);
+          start = true;
+          esc = false;
+          continue;
+       }
+       if (start) {
+          /* First byte of frame is port (high nibble) and command. 
+           * Only port 0 is supported. 
+           */
+          start = false;
+          cmd = ((c & 0xf0) == 0 || c == KISS_RETURN ? c : 0x0f);
+          continue;
+       }
+       if (esc) {
+          c = (c == TFEND ? FEND : (c == TFESC ? FESC : c));
+          esc = false;
+       }
+       else if (c == FESC) {
+          esc = true;
+          continue;
+       }
+
+       if (cmd == KISS_DATA) {
+          if (fbuf_length(&frame) < KISS_MAX_FRAME)
+             fbuf_putChar(&frame, c);
+       }
+       else
+          kiss_command(cmd, c);
+    }
+    fbuf_release(&frame);
+    tx_alive = false;
+}
+
+
+
+/*********************************************************************
+ * Set a channel access parameter from a KISS command frame.
+ *********************************************************************/
+
+static void kiss_command(uint8_t cmd, uint8_t val)
+{
+    switch (cmd) {
+       case KISS_TXDELAY:
+          if (GET_BYTE_PARAM(TXDELAY) != KISS2FLAGS(val))
+             SET_BYTE_PARAM(TXDELAY, KISS2FLAGS(val));
+          break;
+       case KISS_TXTAIL:
+          if (GET_BYTE_PARAM(TXTAIL) != KISS2FLAGS(val))
+             SET_BYTE_PARAM(TXTAIL, KISS2FLAGS(val));
+          break;
+       case KISS_PERSISTENCE:
+          if (GET_BYTE_PARAM(PERSISTENCE) != val)
+             SET_BYTE_PARAM(PERSISTENCE, val);
+          break;
+       case KISS_SLOTTIME:
+          if (GET_BYTE_PARAM(SLOTTIME) != val)
+             SET_BYTE_PARAM(SLOTTIME, val);
+          break;
+    }
+}
+
+
+
+static void kiss_put(uint8_t c)
+{
+    if (c == FEND) {
+       putch(out, FESC);
+       putch(out, TFEND);
+    }
+    else if (c == FESC) {
+       putch(out, FESC);
+       putch(out, TFESC);
+    }
+    else
+       putch(out, c);
+}
+
+
+
+/*********************************************************************
+ * Send received frames to host. 
+ *********************************************************************/
+
+static void kiss_rx_thread()
+{
+    while (kiss_on)
+    {
+        FBUF frame = fbq_get(&kissq);
+        if (!fbuf_empty(&frame)) {
+           fbuf_reset(&frame);
+           putch(out, FEND);
+           putch(out, KISS_DATA);
+           for (uint8_t i=0; i < fbuf_length(&frame); i++)
+              kiss_put(fbuf_getChar(&frame));
+           putch(out, FEND);
+        }
+        fbuf_release(&frame);
+    }
+    rx_alive = false;
+}
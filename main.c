@@ -26,6 +26,8 @@
 #include "usb.h"
 #include "ax25.h"
 #include "config.h"
+#include "journal.h"
+#include "tracklog.h"
 #include "transceiver.h"
 #include "gps.h"
 #include "ui.h"
@@ -42,6 +44,8 @@ const char __attribute__ ((section (".sign"))) firmware_signature[] = "Polaric T
 extern Semaphore cdc_run;   
 extern Stream cdc_instr; 
 extern Stream cdc_outstr;
+extern Stream cdc_data_instr; 
+extern Stream cdc_data_outstr;
 
 fbq_t *outframes;  
 
@@ -175,10 +179,14 @@ int main(void)
       sei();
       t_stackErrorHandler(stackOverflow); 
       fbuf_errorHandler(bufferOverflow);
+      param_cache_init();
       reset_params();
+      journal_init();
+      tracklog_init();
                             
       /* HDLC and AFSK setup */
       mon_init(&cdc_outstr);
+      kiss_init(&cdc_data_instr, &cdc_data_outstr);
       adf7021_init();
       inframes  = hdlc_init_decoder( afsk_init_decoder() );
       outframes = hdlc_init_encoder( afsk_init_encoder() );            
@@ -0,0 +1,201 @@
+/*
+ * Mic-E position encoding. Latitude, message code and the N/S, W/E and
+ * longitude offset flags are carried in the destination address. The
+ * information field has longitude, speed, course and symbol in binary
+ * form, 9 bytes. Altitude is optional (4 bytes). See chapter 10 of
+ * the APRS 1.0.1 protocol specification.
+ *
+ * Positions are encoded with a resolution of 1/100 minute, using
+ * integer arithmetic only.
+ */
+
+#include "mice.h"
+#include <stdlib.h>
+
+#define MICE_BASE  28
+
+
+/* Split 1e-7 degrees into degrees, minutes and 1/100 minutes */
+static void split_deg(int32_t x, uint8_t* deg, uint8_t* min, uint8_t* hun)
+{
+    uint32_t a = labs(x);
+    uint16_t m = ((a % 10000000) * 6 + 5000) / 10000;
+    *deg = a / 10000000;
+    if (m >= 6000) {
+       (*deg)++;
+       m = 0;
+    }
+    *min = m / 100;
+    *hun = m % 100;
+}
+
+
+
+/*************************************************************************
+ * Encode latitude and message code in destination callsign. The SSID
+ * field is not changed.
+ *************************************************************************/
+
+void mice_dest(addr_t* to, posdata_t* pos, uint8_t msg)
+{
+    uint8_t deg, min, hun, i;
+    uint8_t digit[6], flag[6];
+
+    split_deg(pos->latitude, &deg, &min, &hun);
+    digit[0] = deg / 10;  digit[1] = deg % 10;
+    digit[2] = min / 10;  digit[3] = min % 10;
+    digit[4] = hun / 10;  digit[5] = hun % 10;
+
+    flag[0] = msg & 0x04;
+    flag[1] = msg & 0x02;
+    flag[2] = msg & 0x01;
+    flag[3] = (pos->latitude >= 0);
+    split_deg(pos->longitude, &deg, &min, &hun);
+    flag[4] = (deg < 10 || deg >= 100);
+    flag[5] = (pos->longitude < 0);
+
+    for (i=0; i<6; i++)
+       to->callsign[i] = (flag[i] ? 'P' : '0') + digit[i];
+    to->callsign[6] = '\0';
+}
+
+
+
+/*************************************************************************
+ * Encode information field: Data type, longitude, speed, course, symbol
+ * and (optionally) altitude.
+ *************************************************************************/
+
+void mice_info(FBUF* b, posdata_t* pos, char sym, char symtab, bool alt)
+{
+    uint8_t deg, min, hun, dc;
+    uint16_t knots = (pos->speed + 50) / 100;
+    uint16_t crs = pos->course % 360;
+
+    split_deg(pos->longitude, &deg, &min, &hun);
+    fbuf_putChar(b, '`');
+    if (deg < 10)
+       fbuf_putChar(b, deg + 118);
+    else if (deg < 100)
+       fbuf_putChar(b, deg + 28);
+    else if (deg < 110)
+       fbuf_putChar(b, deg + 8);
+    else
+       fbuf_putChar(b, deg - 72);
+    fbuf_putChar(b, min + (min < 10 ? 88 : 28));
+    fbuf_putChar(b, hun + MICE_BASE);
+
+    /* Speed (knots) and course. Course 0 means unknown, so north is 360.
+     * Control characters are avoided in the first two bytes by using
+     * the alternative encodings (speed + 800 and course + 400).
+     */
+    if (knots > 799)
+       knots = 799;
+    if (crs == 0)
+       crs = 360;
+    dc = (knots % 10) * 10 + crs / 100;
+    if (dc < 4)
+       dc += 4;
+    fbuf_putChar(b, knots / 10 + (knots < 40 ? 108 : 28));
+    fbuf_putChar(b, dc + MICE_BASE);
+    fbuf_putChar(b, crs % 100 + MICE_BASE);
+
+    fbuf_putChar(b, sym);
+    fbuf_putChar(b, symtab);
+
+    /* Altitude in meters relative to 10 km below sea level, base 91 */
+    if (alt && pos->altitude >= 0) {
+       uint32_t a = (pos->altitude + 5) / 10 + 10000;
+       fbuf_putChar(b, a / 8281 + 33);
+       fbuf_putChar(b, (a / 91) % 91 + 33);
+       fbuf_putChar(b, a % 91 + 33);
+       fbuf_putChar(b, '}');
+    }
+}
+
+
+
+/*************************************************************************
+ * Decode Mic-E position from destination address and information
+ * field (len bytes from current read position of buffer). Return false
+ * if it is not a Mic-E position.
+ *************************************************************************/
+
+static uint8_t dest_digit(char c)
+{
+    if (c >= 'P' && c <= 'Y')
+       return c - 'P';
+    if (c >= 'A' && c <= 'J')
+       return c - 'A';
+    if (c >= '0' && c <= '9')
+       return c - '0';
+    return 0;     /* Position ambiguity (K, L, Z) */
+}
+
+
+bool mice_decode(addr_t* to, FBUF* b, uint8_t len, posdata_t* pos)
+{
+    uint8_t i, c[9], d[4];
+    uint16_t deg, min, speed, crs;
+    int32_t x;
+    char* s = to->callsign;
+
+    if (len < 9)
+       return false;
+    c[0] = fbuf_getChar(b);
+    if (c[0] != '`' && c[0] != '\'')
+       return false;
+    for (i=0; i<6; i++)
+       if (s[i] < '0' || s[i] > 'Z')
+          return false;
+    for (i=1; i<9; i++)
+       c[i] = fbuf_getChar(b);
+
+    /* Latitude */
+    deg = dest_digit(s[0]) * 10 + dest_digit(s[1]);
+    min = dest_digit(s[2]) * 1000 + dest_digit(s[3]) * 100 +
+          dest_digit(s[4]) * 10 + dest_digit(s[5]);
+    x = deg * 10000000L + (min * 10000L + 3) / 6;
+    pos->latitude = (s[3] >= 'P' ? x : -x);
+
+    /* Longitude */
+    deg = c[1] - MICE_BASE;
+    if (s[4] >= 'P')
+       deg += 100;
+    if (deg >= 190)
+       deg -= 190;
+    else if (deg >= 180)
+       deg -= 80;
+    min = c[2] - MICE_BASE;
+    if (min >= 60)
+       min -= 60;
+    min = min * 100 + c[3] - MICE_BASE;
+    x = deg * 10000000L + (min * 10000L + 3) / 6;
+    pos->longitude = (s[5] >= 'P' ? -x : x);
+
+    /* Speed and course */
+    speed = (c[4] - MICE_BASE) * 10 + (c[5] - MICE_BASE) / 10;
+    if (speed >= 800)
+       speed -= 800;
+    crs = ((c[5] - MICE_BASE) % 10) * 100 + c[6] - MICE_BASE;
+    if (crs >= 400)
+       crs -= 400;
+    pos->speed = speed * 100;
+    pos->course = crs % 360;
+
+    /* Altitude, possibly after a type byte */
+    pos->altitude = -1;
+    if (len >= 13) {
+       for (i=0; i<4; i++)
+          d[i] = fbuf_getChar(b);
+       if (d[3] != '}' && len >= 14) {
+          for (i=0; i<3; i++)
+             d[i] = d[i+1];
+          d[3] = fbuf_getChar(b);
+       }
+       if (d[3] == '}')
+          pos->altitude =
+             (((d[0] - 33) * 8281L + (d[1] - 33) * 91 + (d[2] - 33)) - 10000) * 10;
+    }
+    return true;
+}
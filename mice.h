@@ -0,0 +1,24 @@
+#if !defined __MICE_H__
+#define __MICE_H__
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include "ax25.h"
+#include "fbuf.h"
+#include "gps.h"
+
+/* Standard Mic-E message codes (message bits A, B, C) */
+#define MICE_OFF_DUTY    7
+#define MICE_EN_ROUTE    6
+#define MICE_IN_SERVICE  5
+#define MICE_RETURNING   4
+#define MICE_COMMITTED   3
+#define MICE_SPECIAL     2
+#define MICE_PRIORITY    1
+#define MICE_EMERGENCY   0
+
+void mice_dest(addr_t*, posdata_t*, uint8_t);
+void mice_info(FBUF*, posdata_t*, char, char, bool);
+bool mice_decode(addr_t*, FBUF*, uint8_t, posdata_t*);
+
+#endif /* __MICE_H__ */
@@ -5,6 +5,8 @@
 #include "config.h"
 #include "ax25.h"
 #include "hdlc.h"
+#include "gps.h"
+#include "mice.h"
 
 BCond mon_ok;
    /* External variable in afsk_rx and afsk_tx. 
@@ -14,6 +16,7 @@ static bool mon_on = false;
 static stream_t *out;
 static FBQ mon;
 static void mon_thread(void);
+static void mon_show_mice(FBUF*);
 
 FBQ* mon_q = &mon;
 
@@ -68,6 +71,7 @@ static void mon_thread()
            /* Display it */
            ax25_display_frame(out, &frame);
            putstr_P(out, PSTR("\r\n"));
+           mon_show_mice(&frame);
         }
         /* And dispose the frame. Note that also an empty frame should be disposed! */
         fbuf_release(&frame);    
@@ -76,3 +80,30 @@ static void mon_thread()
 
 
 
+/*************************************************************************
+ * If frame is a Mic-E position report, show the decoded position.
+ *************************************************************************/
+
+static void mon_show_mice(FBUF* frame)
+{
+    ax25_hdr_t hdr;
+    addr_t to;
+    posdata_t pos;
+    char buf[48], latbuf[14], longbuf[14];
+
+    if (!ax25_hdr_view(&hdr, frame) || hdr.ctrl != FTYPE_UI ||
+          fbuf_length(frame) <= ax25_hdr_len(&hdr))
+       return;
+    ax25_addr_get(&hdr, AX25_TO, &to);
+    fbuf_rseek(frame, ax25_hdr_len(&hdr));
+    if (!mice_decode(&to, frame, fbuf_length(frame) - ax25_hdr_len(&hdr), &pos))
+       return;
+    sprintf_P(buf, PSTR("  [Mic-E %s %s %u/%u\0"), deg2str(latbuf, pos.latitude),
+       deg2str(longbuf, pos.longitude), pos.course, pos.speed / 100);
+    putstr(out, buf);
+    if (pos.altitude >= 0) {
+       sprintf_P(buf, PSTR(" %ldm\0"), pos.altitude / 10);
+       putstr(out, buf);
+    }
+    putstr_P(out, PSTR("]\r\n"));
+}
@@ -0,0 +1,83 @@
+/*
+ * Rate limiting of digipeated frames per source callsign.
+ *
+ * Token bucket with lazy refill (generic cell rate algorithm): Each
+ * source has a theoretical arrival time (TAT). A frame is allowed if TAT
+ * is at most n-1 periods ahead of now, and TAT is then advanced one
+ * period (window/n). This allows a burst of n frames and then one frame
+ * per period.
+ *
+ * Only a 16 bit hash of the callsign and TAT (seconds) are stored, in a
+ * small open-addressed hash table like the heard list. Entries with TAT
+ * in the past are free slots. Since a source only holds an entry for up
+ * to one window after it was last digipeated, the table can serve a
+ * few hundred stations. If all the probed slots are in use, the one
+ * that expires first is replaced.
+ */
+
+#include "kernel/kernel.h"
+#include "kernel/timer.h"
+#include "defines.h"
+#include "digipeater.h"
+
+
+ typedef struct _ritem {
+      uint16_t key;
+      uint16_t tat;      /* Theoretical arrival time (seconds) */
+ } RItem;
+
+ static RItem rlist[RATELIMIT_SIZE];
+
+ #define HOME(x)   (((x) ^ ((x) >> 8)) & (RATELIMIT_SIZE-1))
+ #define NEXT(i)   (((i) + 1) & (RATELIMIT_SIZE-1))
+
+
+ static uint16_t now()
+    { return timer_ticks() / TIMER_RESOLUTION; }
+
+
+/*****************************************************************
+ * Return true if entry is in use, i.e. TAT is in the future.
+ * Time wraps around, so TAT must be within the window.
+ *****************************************************************/
+
+ static bool live(RItem* r, uint16_t t, uint16_t window)
+    { return (uint16_t) (r->tat - t - 1) < window; }
+
+
+
+ /**************************************************************
+  * Return true if a frame from source with hash key is allowed,
+  * with at most n frames per window (seconds).
+  **************************************************************/
+
+ bool rlist_allow(uint16_t key, uint8_t n, uint16_t window)
+ {
+   uint16_t t = now();
+   uint16_t period = window / n;
+   uint8_t i = HOME(key), p;
+   RItem *r = NULL, *victim = NULL;
+
+   for (p=0; p<RATELIMIT_PROBES; p++, i = NEXT(i)) {
+      if (!live(&rlist[i], t, window)) {
+         if (victim == NULL || live(victim, t, window))
+            victim = &rlist[i];
+      }
+      else if (rlist[i].key == key) {
+         r = &rlist[i];
+         break;
+      }
+      else if (victim == NULL ||
+            (live(victim, t, window) && (int16_t) (rlist[i].tat - victim->tat) < 0))
+         victim = &rlist[i];
+   }
+   if (r == NULL) {
+      r = victim;
+      r->key = key;
+      r->tat = t;
+   }
+   if ((uint16_t) (r->tat - t) > (n-1) * period)
+      return false;
+   r->tat += period;
+   return true;
+ }
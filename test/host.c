@@ -0,0 +1,238 @@
+/*
+ * Host versions of the kernel, timer and parameter functions, and of
+ * hardware related functions called by the modules under test.
+ *
+ * Threads are not scheduled. A test calls a thread function with
+ * host_run(), which returns when the thread terminates or would block.
+ * The functions are weak, so a test can replace any of them.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include "defines.h"
+#include "kernel/kernel.h"
+#include "kernel/timer.h"
+#include "kernel/stream.h"
+#include "config.h"
+#include "ax25.h"
+#include "hdlc.h"
+#include "gps.h"
+#include "host.h"
+
+#define WEAK __attribute__((weak))
+
+volatile uint8_t SREG;
+volatile uint8_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF;
+volatile uint8_t DDRA, DDRB, DDRC, DDRD, DDRE, DDRF;
+volatile uint8_t PINA, PINB, PINC, PIND, PINE, PINF;
+
+uint8_t blink_length, blink_interval;
+
+uint32_t host_ticks = 0;
+FBQ* host_rxq[3];
+int host_failures = 0;
+
+static jmp_buf* blocked = NULL;
+
+
+
+/*************************************************************************
+ * Run a thread function until it terminates (return true) or
+ * blocks (return false). A blocked thread is abandoned.
+ *************************************************************************/
+
+bool host_run(void (*f)(void))
+{
+    jmp_buf env, *prev = blocked;
+    bool done = false;
+
+    blocked = &env;
+    if (setjmp(env) == 0) {
+       f();
+       done = true;
+    }
+    blocked = prev;
+    return done;
+}
+
+
+/* Wall clock time in seconds, for benchmarks */
+double host_time()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+
+/*************************************************************************
+ * Kernel
+ *************************************************************************/
+
+WEAK void _t_start(void (*f)(void), TCB* tcb, uint16_t stsize) {}
+WEAK void t_yield() {}
+
+WEAK void cond_init(Cond* c)
+   { c->qfirst = c->qlast = NULL; }
+
+WEAK void wait(Cond* c)
+{
+    if (blocked != NULL)
+       longjmp(*blocked, 1);
+    printf("wait() outside of host_run: would block forever\n");
+    exit(1);
+}
+
+WEAK void notify(Cond* c) {}
+WEAK void notifyAll(Cond* c) {}
+WEAK bool hasWaiters(Cond* c)
+   { return false; }
+
+WEAK void bcond_init(BCond* c, bool v)
+   { c->val = v; }
+WEAK void bcond_set(BCond* c)
+   { c->val = true; }
+WEAK void bcond_clear(BCond* c)
+   { c->val = false; }
+WEAK void bcond_wait(BCond* c)
+   { if (!c->val) wait(&c->waiters); }
+
+WEAK void sem_init(Semaphore* s, uint16_t cnt)
+   { s->cnt = cnt; }
+WEAK void sem_set(Semaphore* s, uint16_t cnt)
+   { s->cnt = cnt; }
+WEAK void sem_up(Semaphore* s)
+   { s->cnt++; }
+WEAK void sem_down(Semaphore* s)
+{
+    if (s->cnt == 0)
+       wait(&s->waiters);
+    s->cnt--;
+}
+
+WEAK bool sem_nb_down(Semaphore* s)
+{
+    if (s->cnt == 0)
+       return false;
+    s->cnt--;
+    return true;
+}
+
+
+
+/*************************************************************************
+ * Timer. Time only advances when a test sets host_ticks or sleeps.
+ *************************************************************************/
+
+WEAK uint32_t timer_ticks()
+   { return host_ticks; }
+WEAK void timer_set(Timer* t, uint16_t ticks)
+   { t->count = ticks; }
+WEAK void timer_cancel(Timer* t)
+   { t->count = 0; }
+WEAK void sleep(uint16_t ticks)
+   { host_ticks += ticks; }
+
+
+
+/*************************************************************************
+ * Parameters are read from the defaults until they are set.
+ *************************************************************************/
+
+#define MAX_SET 32
+static const void* set_addr[MAX_SET];
+static uint8_t n_set = 0;
+static uint16_t param_gen = 0;
+
+static bool is_set(const void* ee_addr)
+{
+    uint8_t i;
+    for (i=0; i<n_set; i++)
+       if (set_addr[i] == ee_addr)
+          return true;
+    return false;
+}
+
+static void mark_set(const void* ee_addr)
+{
+    if (!is_set(ee_addr) && n_set < MAX_SET)
+       set_addr[n_set++] = ee_addr;
+    param_gen++;
+}
+
+
+WEAK int get_param(const void* ee_addr, void* ram_addr, uint8_t size, PGM_P default_addr)
+{
+    memcpy(ram_addr, (is_set(ee_addr) ? ee_addr : (const void*) default_addr), size);
+    return 0;
+}
+
+WEAK void set_param(void* ee_addr, const void* ram_addr, uint8_t size)
+{
+    memcpy(ee_addr, ram_addr, size);
+    mark_set(ee_addr);
+}
+
+WEAK uint8_t get_byte_param(const uint8_t* ee_addr, PGM_P default_addr)
+   { return (is_set(ee_addr) ? *ee_addr : *(const uint8_t*) default_addr); }
+
+WEAK void set_byte_param(uint8_t* ee_addr, uint8_t byte)
+{
+    *ee_addr = byte;
+    mark_set(ee_addr);
+}
+
+WEAK uint16_t param_generation()
+   { return param_gen; }
+
+
+
+/*************************************************************************
+ * Hardware and other modules
+ *************************************************************************/
+
+WEAK void radio_require() {}
+WEAK void radio_release() {}
+WEAK void afsk_enable_decoder() {}
+WEAK void afsk_disable_decoder() {}
+
+WEAK void hdlc_subscribe_rx(FBQ* q, uint8_t i)
+   { host_rxq[i] = q; }
+
+WEAK Stream* uart_rx_init(uint16_t baud, bool echo)
+   { return NULL; }
+WEAK Stream* uart_tx_init(uint16_t baud)
+   { return NULL; }
+WEAK void uart_set_baud(uint16_t baud) {}
+
+WEAK uint8_t journal_get_byte(uint8_t key)
+   { return 1; }
+WEAK bool journal_get(uint8_t key, void* val)
+   { return false; }
+WEAK void journal_put(uint8_t key, const void* val) {}
+WEAK void journal_put_byte(uint8_t key, uint8_t val) {}
+
+WEAK fbq_t *outframes, *mqueue;
+WEAK bool is_off;
+
+WEAK void str2addr(addr_t* a, const char* str, bool digi) {}
+WEAK void ax25_encode_header(FBUF* b, addr_t* from, addr_t* to, addr_t digis[],
+                             uint8_t ndigis, uint8_t ctrl, uint8_t pid) {}
+WEAK void ax25_own_header(FBUF* b) {}
+WEAK uint8_t chanstat_busy(uint8_t t)
+   { return 0; }
+WEAK bool hdlc_enc_packets_waiting()
+   { return false; }
+WEAK void hdlc_get_txstat(txstat_t* s) {}
+WEAK void mice_dest(addr_t* a, posdata_t* pos, uint8_t x) {}
+WEAK void mice_info(FBUF* b, posdata_t* pos, char sym, char symtab, bool x) {}
+WEAK void tracklog_put(posdata_t* pos) {}
+WEAK void uart_rx_pause() {}
+WEAK void uart_rx_resume() {}
+WEAK void beep(uint16_t t) {}
+WEAK void beeps(char* s) {}
+WEAK float batt_voltage()
+   { return 0; }
@@ -0,0 +1,29 @@
+/*
+ * Support for host tests: See host.c
+ */
+
+#if !defined __HOST_H__
+#define __HOST_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "fbuf.h"
+
+/* Time returned by timer_ticks(). Advanced by sleep() */
+extern uint32_t host_ticks;
+
+/* Receive queues subscribed with hdlc_subscribe_rx() */
+extern FBQ* host_rxq[3];
+
+/* Number of failed checks */
+extern int host_failures;
+
+#define CHECK(c) \
+   do { if (!(c)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #c); \
+                    host_failures++; } } while (0)
+
+bool   host_run(void (*)(void));
+double host_time(void);
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ * Host stub of <avr/eeprom.h>. Parameters (EEMEM) are ordinary 
+ * variables, accessed through the functions in host.c. 
+ */
+#if !defined __HOST_AVR_EEPROM_H__
+#define __HOST_AVR_EEPROM_H__
+
+#include <stdint.h>
+
+#define EEMEM
+#define eeprom_is_ready()   1
+#define eeprom_busy_wait()
+
+#endif
@@ -0,0 +1,9 @@
+/* Host stub of <avr/interrupt.h> */
+#if !defined __HOST_AVR_INTERRUPT_H__
+#define __HOST_AVR_INTERRUPT_H__
+
+#define ISR(vector)  void vector(void)
+#define sei()
+#define cli()
+
+#endif
@@ -0,0 +1,17 @@
+/*
+ * Host stub of <avr/io.h>. I/O registers are plain variables 
+ * (defined in host.c). 
+ */
+#if !defined __HOST_AVR_IO_H__
+#define __HOST_AVR_IO_H__
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF;
+extern volatile uint8_t DDRA, DDRB, DDRC, DDRD, DDRE, DDRF;
+extern volatile uint8_t PINA, PINB, PINC, PIND, PINE, PINF;
+
+#endif
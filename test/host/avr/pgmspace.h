@@ -0,0 +1,40 @@
+/*
+ * Host stub of <avr/pgmspace.h>. Program memory is ordinary memory. 
+ */
+#if !defined __HOST_AVR_PGMSPACE_H__
+#define __HOST_AVR_PGMSPACE_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#define PROGMEM
+#define PSTR(s)            (s)
+typedef const char*        PGM_P;
+
+#define pgm_read_byte(a)   (*(const uint8_t*) (a))
+#define pgm_read_word(a)   (*(const uint16_t*) (a))
+#define pgm_read_dword(a)  (*(const uint32_t*) (a))
+
+#define memcpy_P           memcpy
+#define strlen_P           strlen
+#define strcmp_P           strcmp
+#define strncmp_P          strncmp
+#define strcpy_P           strcpy
+#define strncasecmp_P      strncasecmp
+#define sscanf_P           sscanf
+
+/* Not checked as a format: The firmware's formats are for AVR types,
+ * where e.g. uint32_t is unsigned long. */
+static inline int sprintf_P(char* buf, PGM_P fmt, ...)
+{
+    va_list ap;
+    int n;
+    va_start(ap, fmt);
+    n = vsprintf(buf, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+#endif
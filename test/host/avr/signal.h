@@ -0,0 +1,2 @@
+/* Host stub of <avr/signal.h> */
+#include <avr/interrupt.h>
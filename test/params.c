@@ -0,0 +1,6 @@
+/*
+ * Parameters and their default values, as defined by config.c
+ */
+
+#define __CONFIG_C__
+#include "config.h"
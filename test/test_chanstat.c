@@ -0,0 +1,176 @@
+/*
+ * Channel statistics test.
+ *
+ * Minutes of channel traffic are fed to the statistics: channel state
+ * samples, frames and carrier events without a frame. Each minute has
+ * its own busy time and frame count, so that the 1, 10 and 60 minute
+ * windows can be checked as the minute buckets roll over into the
+ * 10-minute buckets, and these roll over in turn. Before a full minute
+ * has been monitored, the current minute must be scaled to a minute.
+ */
+
+#include "../chanstat.c"
+#include "host.h"
+
+#define MINUTES  75
+
+
+
+/*************************************************************************
+ * Traffic
+ *************************************************************************/
+
+/* Busy percent, frames and bad carrier events of minute m */
+static uint8_t  m_busy(int m)   { return (m * 7) % 100; }
+static uint16_t m_frames(int m) { return 1 + (m * 13) % 50; }
+static uint16_t m_bad(int m)    { return m % 4; }
+
+
+/* Carrier events without a frame are counted when the next carrier
+ * starts, so these come before the frames. */
+static void events(uint16_t nframes, uint16_t nbad)
+{
+    uint16_t i;
+    for (i=0; i<nbad; i++) {
+       chanstat_carrier(true);
+       chanstat_carrier(false);
+    }
+    for (i=0; i<nframes; i++) {
+       chanstat_carrier(true);
+       chanstat_frame(50);
+       chanstat_carrier(false);
+    }
+}
+
+
+/* n channel state samples, of which the first nbusy are busy */
+static void samples_(uint16_t n, uint16_t nbusy)
+{
+    uint16_t i;
+    for (i=0; i<n; i++)
+       chanstat_sample(i < nbusy);
+}
+
+
+static void minute(int m)
+{
+    events(m_frames(m), m_bad(m));
+    samples_(SAMPLES_PER_MIN, (uint32_t) SAMPLES_PER_MIN * m_busy(m) / 100);
+}
+
+
+
+/*************************************************************************
+ * Expected statistics, after minutes 0 to m-1
+ *************************************************************************/
+
+static void expect(uint8_t window, int m, chanstat_t* st)
+{
+    int from, i, k, n = 0;
+    uint16_t b = 0, bad = 0;
+    uint32_t f = 0;
+
+    if (window >= 60 && m >= 10) {
+       /* Whole 10 minute periods, busy time averaged per period */
+       k = m / 10;
+       for (i = (k > 6 ? k - 6 : 0); i < k; i++, n++) {
+          uint16_t pb = 0;
+          for (from = i*10; from < i*10 + 10; from++) {
+             pb += m_busy(from);
+             f += m_frames(from);
+             bad += m_bad(from);
+          }
+          b += pb / 10;
+       }
+       st->busy = b / n;
+       st->frames = f * 10 / (n * 10);
+       st->bad = bad;
+       return;
+    }
+
+    /* Minutes: The last one, or the last 10 */
+    from = (window <= 1 ? m - 1 : (m > 10 ? m - 10 : 0));
+    for (i=from; i<m; i++, n++) {
+       b += m_busy(i);
+       f += m_frames(i);
+       bad += m_bad(i);
+    }
+    st->busy = b / n;
+    st->frames = f * 10 / n;
+    st->bad = bad;
+}
+
+
+
+/*************************************************************************
+ * Tests
+ *************************************************************************/
+
+static void check_partial()
+{
+    chanstat_t st;
+
+    chanstat_get(1, &st);
+    CHECK(st.busy == 0 && st.frames == 0 && st.bad == 0);
+
+    /* Half a minute, 25% busy, 3 frames: 6 frames per minute */
+    events(3, 2);
+    samples_(SAMPLES_PER_MIN / 2, SAMPLES_PER_MIN / 8);
+    chanstat_get(1, &st);
+    CHECK(st.busy == 25);
+    CHECK(st.frames == 60);
+    CHECK(st.bad == 2);
+    chanstat_get(60, &st);
+    CHECK(st.busy == 25 && st.frames == 60 && st.bad == 2);
+
+    /* A tenth of a minute more, 1 frame: 4 frames in 0.6 minute */
+    events(1, 0);
+    samples_(SAMPLES_PER_MIN / 10, 0);
+    chanstat_get(10, &st);
+    CHECK(st.busy == 20);
+    CHECK(st.frames == 66);
+
+    /* Very short time: Frames per minute saturate */
+    t_minutes = samples = busy = frames = bad = 0;
+    events(200, 0);
+    samples_(1, 1);
+    chanstat_get(1, &st);
+    CHECK(st.busy == 100 && st.frames == 0xffff);
+    t_minutes = samples = busy = frames = bad = 0;
+    pending = got_frame = false;
+}
+
+
+static void check_rollover()
+{
+    static const uint8_t win[3] = {1, 10, 60};
+    chanstat_t st, ex;
+    int m, i, errors = 0;
+
+    for (m=0; m<MINUTES; m++) {
+       minute(m);
+       for (i=0; i<3; i++) {
+          chanstat_get(win[i], &st);
+          expect(win[i], m + 1, &ex);
+          if (st.busy != ex.busy || st.frames != ex.frames || st.bad != ex.bad) {
+             if (errors++ < 10)
+                printf("Minute %d, %u min window: busy %u, frames %u, bad %u. Expected %u, %u, %u\n",
+                   m + 1, win[i], st.busy, st.frames, st.bad, ex.busy, ex.frames, ex.bad);
+          }
+       }
+    }
+    CHECK(errors == 0);
+    CHECK(t_minutes == MINUTES);
+    CHECK(n_min == 10 && n_ten == 6);
+}
+
+
+
+int main()
+{
+    check_partial();
+    check_rollover();
+
+    printf("%s\n", (host_failures == 0 ? "Ok" : "FAILED"));
+    return (host_failures == 0 ? 0 : 1);
+}
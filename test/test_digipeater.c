@@ -0,0 +1,333 @@
+/*
+ * Digipeater path processing test.
+ *
+ * Frames with different paths are given to the digipeater, and the path
+ * of the digipeated frame is compared with the expected one (or the
+ * frame must not be digipeated). Covers each rule: WIDE1-1 in fill-in
+ * mode, WIDEn-N and TRACEn-N (also with a full path), the hop limit,
+ * invalid N, SAR preemption, preemption on own callsign or alias, and
+ * aliases with and without SSID. Also tests restarting the digipeater
+ * while a frame is held for viscous delay.
+ */
+
+#include "../ratelimit.c"
+#include "../ax25.c"
+#include "../digipeater.c"
+#include "host.h"
+
+static FBQ txq;
+fbq_t* outframes = &txq;
+
+uint32_t afsk_ptt_ticks()
+   { return 0; }
+
+/* Every frame is new */
+bool hlist_exists(uint16_t x) { return false; }
+void hlist_add(uint16_t x) {}
+
+static uint8_t n_threads = 0, n_joined = 0;
+
+void _t_start(void (*f)(void), TCB* tcb, uint16_t stsize)
+   { n_threads++; }
+
+
+/*
+ * digipeater_activate waits for the threads of the previous session to
+ * terminate. Let them run when it sleeps.
+ */
+void sleep(uint16_t ticks)
+{
+    host_ticks += ticks;
+    if (digi_alive && host_run(digipeater_thread))
+       n_joined++;
+    if (delay_alive && host_run(delay_thread))
+       n_joined++;
+}
+
+#define INFO "!6000.00N/01030.00E-Test"
+
+
+
+/*************************************************************************
+ * Digipeat a frame from LA1ABC to APRS via path, given as a comma
+ * separated list of addresses, with a '*' after used ones. Return the
+ * path of the digipeated frame in the same form, or "-" if it is not
+ * digipeated.
+ *************************************************************************/
+
+static const char* digi(const char* path)
+{
+    static char out[100];
+    char p[100], a[16], *s;
+    addr_t from, to, digis[7];
+    uint8_t n = 0, ctrl, pid, i;
+    FBUF f;
+
+    str2addr(&from, "LA1ABC-7", false);
+    str2addr(&to, "APRS", false);
+    strcpy(p, path);
+    for (s = strtok(p, ","); s != NULL && n < 7; s = strtok(NULL, ",")) {
+       bool used = (s[strlen(s) - 1] == '*');
+       if (used)
+          s[strlen(s) - 1] = '\0';
+       str2addr(&digis[n++], s, used);
+    }
+    fbuf_new(&f);
+    ax25_encode_header(&f, &from, &to, digis, n, FTYPE_UI, PID_NO_L3);
+    fbuf_putstr(&f, INFO);
+
+    update_aliases();
+    check_frame(&f);
+    fbuf_release(&f);
+    if (fbq_eof(&txq))
+       return "-";
+
+    /* Digipeated frame: Same addresses and information field */
+    f = fbq_get(&txq);
+    n = ax25_decode_header(&f, &from, &to, digis, &ctrl, &pid);
+    CHECK(strcmp(from.callsign, "LA1ABC") == 0 && from.ssid == 7);
+    CHECK(strcmp(to.callsign, "APRS") == 0);
+    CHECK(ctrl == FTYPE_UI && pid == PID_NO_L3);
+    for (i=0; i<strlen(INFO) && fbuf_getChar(&f) == INFO[i]; i++)
+       ;
+    CHECK(i == strlen(INFO) && fbuf_eof(&f));
+    fbuf_release(&f);
+
+    out[0] = '\0';
+    for (i=0; i<n; i++) {
+       if (i > 0)
+          strcat(out, ",");
+       strcat(out, addr2str(a, &digis[i]));
+       if (digis[i].flags & FLAG_DIGI)
+          strcat(out, "*");
+    }
+    return out;
+}
+
+
+#define CHECK_DIGI(path, expect) \
+   do { const char* r = digi(path); \
+        if (strcmp(r, (expect)) != 0) { \
+           printf("%s:%d: %s gave %s, expected %s\n", __FILE__, __LINE__, (path), r, (expect)); \
+           host_failures++; } } while (0)
+
+
+static void set_mode(bool wide1, bool widen, bool sar, bool preempt, uint8_t maxhops)
+{
+    SET_BYTE_PARAM(DIGIPEATER_WIDE1, wide1);
+    SET_BYTE_PARAM(DIGIPEATER_WIDEN, widen);
+    SET_BYTE_PARAM(DIGIPEATER_SAR, sar);
+    SET_BYTE_PARAM(DIGIPEATER_PREEMPT, preempt);
+    SET_BYTE_PARAM(DIGI_MAXHOPS, maxhops);
+}
+
+
+
+/*************************************************************************
+ * Tests
+ *************************************************************************/
+
+static void check_wide1()
+{
+    /* Fill-in mode: Only WIDE1-1 */
+    set_mode(true, false, false, false, 2);
+    CHECK_DIGI("WIDE1-1", "LD9TS*,WIDE1*");
+    CHECK_DIGI("WIDE1-1,WIDE2-1", "LD9TS*,WIDE1*,WIDE2-1");
+    CHECK_DIGI("WIDE2-2", "-");
+    CHECK_DIGI("WIDE2-1", "-");
+    CHECK_DIGI("LA2XY*,WIDE1-1", "LA2XY*,LD9TS*,WIDE1*");
+    CHECK_DIGI("TRACE1-1", "-");
+
+    /* Neither mode */
+    set_mode(false, false, false, false, 2);
+    CHECK_DIGI("WIDE1-1", "-");
+
+    /* WIDEn-N mode also takes WIDE1-1 */
+    set_mode(false, true, false, false, 2);
+    CHECK_DIGI("WIDE1-1,WIDE2-1", "LD9TS*,WIDE1*,WIDE2-1");
+}
+
+
+static void check_widen()
+{
+    set_mode(true, true, false, false, 2);
+
+    /* N is decremented. WIDEn* when it reaches 0. MYCALL is not inserted */
+    CHECK_DIGI("WIDE2-2", "WIDE2-1");
+    CHECK_DIGI("LD9XX*,WIDE2-1", "LD9XX*,WIDE2*");
+    CHECK_DIGI("WIDE1*,WIDE2-2", "WIDE1*,WIDE2-1");
+    CHECK_DIGI("WIDE2*,WIDE2-1", "WIDE2*,WIDE2*");
+    CHECK_DIGI("WIDE2-1", "WIDE2*");
+
+    /* n above the hop limit */
+    CHECK_DIGI("WIDE3-3", "-");
+    CHECK_DIGI("WIDE3-1", "-");
+    CHECK_DIGI("TRACE3-2", "-");
+    CHECK_DIGI("WIDE7-7", "-");
+
+    /* N above n, and N of 0 */
+    CHECK_DIGI("WIDE2-3", "-");
+    CHECK_DIGI("WIDE1-2", "-");
+    CHECK_DIGI("WIDE2", "-");
+
+    /* Not WIDEn-N */
+    CHECK_DIGI("WIDE-1", "-");
+    CHECK_DIGI("WIDE8-1", "-");
+    CHECK_DIGI("WIDE22-1", "-");
+    CHECK_DIGI("WIDEX-1", "-");
+
+    /* Higher hop limit */
+    set_mode(false, true, false, false, 7);
+    CHECK_DIGI("WIDE7-7", "WIDE7-6");
+    CHECK_DIGI("WIDE3-1", "WIDE3*");
+}
+
+
+static void check_trace()
+{
+    set_mode(false, true, false, false, 3);
+
+    /* MYCALL is inserted and N decremented */
+    CHECK_DIGI("TRACE3-3", "LD9TS*,TRACE3-2");
+    CHECK_DIGI("LA2XY*,TRACE3-2", "LA2XY*,LD9TS*,TRACE3-1");
+    CHECK_DIGI("LA2XY*,LA3XY*,TRACE3-1", "LA2XY*,LA3XY*,LD9TS*,TRACE3*");
+    CHECK_DIGI("TRACE2-1,WIDE2-2", "LD9TS*,TRACE2*,WIDE2-2");
+
+    /* Full path: Nothing can be inserted, N is decremented */
+    CHECK_DIGI("LA1XY*,LA2XY*,LA3XY*,LA4XY*,LA5XY*,LA6XY*,TRACE3-3",
+               "LA1XY*,LA2XY*,LA3XY*,LA4XY*,LA5XY*,LA6XY*,TRACE3-2");
+    CHECK_DIGI("LA1XY*,LA2XY*,LA3XY*,LA4XY*,LA5XY*,TRACE3-3,WIDE2-2",
+               "LA1XY*,LA2XY*,LA3XY*,LA4XY*,LA5XY*,TRACE3-2,WIDE2-2");
+    CHECK_DIGI("LA1XY*,LA2XY*,LA3XY*,LA4XY*,LA5XY*,LA6XY*,WIDE1-1",
+               "LA1XY*,LA2XY*,LA3XY*,LA4XY*,LA5XY*,LA6XY*,WIDE1*");
+
+    /* Hop limit and N */
+    CHECK_DIGI("TRACE4-4", "-");
+    CHECK_DIGI("TRACE3-4", "-");
+}
+
+
+static void check_sar()
+{
+    set_mode(true, false, true, false, 2);
+
+    /* SAR anywhere in the path is moved first */
+    CHECK_DIGI("SAR", "LD9TS*,SAR*");
+    CHECK_DIGI("WIDE1-1,SAR", "LD9TS*,SAR*,WIDE1-1");
+    CHECK_DIGI("WIDE3-3,WIDE2-2,SAR-5", "LD9TS*,SAR*,WIDE3-3,WIDE2-2");
+
+    /* Not when the frame has been digipeated by others first */
+    CHECK_DIGI("LA2XY*,SAR", "-");
+    CHECK_DIGI("LA2XY*,WIDE1-1,SAR", "LA2XY*,LD9TS*,WIDE1*,SAR");
+
+    /* SAR mode off */
+    set_mode(true, false, false, false, 2);
+    CHECK_DIGI("SAR", "-");
+    CHECK_DIGI("WIDE1-1,SAR", "LD9TS*,WIDE1*,SAR");
+}
+
+
+static void check_preempt()
+{
+    set_mode(true, false, false, true, 2);
+
+    /* Unused path elements before own callsign or alias are removed */
+    CHECK_DIGI("LA2XY,LD9TS,WIDE2-1", "LD9TS*,WIDE2-1");
+    CHECK_DIGI("LA2XY*,LA3XY,LA4XY,RELAY", "LA2XY*,LD9TS*");
+    CHECK_DIGI("LA2XY,TEST-3", "LD9TS*");
+    CHECK_DIGI("LA2XY,TEST", "-");
+    CHECK_DIGI("LA2XY,LA3XY", "-");
+
+    /* The first unused element takes precedence */
+    CHECK_DIGI("WIDE1-1,LD9TS", "LD9TS*,WIDE1*,LD9TS");
+
+    /* Preemption off */
+    set_mode(true, false, false, false, 2);
+    CHECK_DIGI("LA2XY,LD9TS,WIDE2-1", "-");
+}
+
+
+static void check_alias()
+{
+    set_mode(false, false, false, false, 2);
+
+    /* Own callsign, and aliases without and with SSID. SSID must match */
+    CHECK_DIGI("LD9TS", "LD9TS*");
+    CHECK_DIGI("LD9TS,WIDE2-1", "LD9TS*,WIDE2-1");
+    CHECK_DIGI("LD9TS-1", "-");
+    CHECK_DIGI("RELAY", "LD9TS*");
+    CHECK_DIGI("RELAY-1", "-");
+    CHECK_DIGI("TEST-3", "LD9TS*");
+    CHECK_DIGI("TEST", "-");
+    CHECK_DIGI("TEST-4", "-");
+    CHECK_DIGI("LA2XY*,RELAY,WIDE2-2", "LA2XY*,LD9TS*,WIDE2-2");
+
+    /* Callsign must match exactly */
+    CHECK_DIGI("RELAYX", "-");
+    CHECK_DIGI("RELA", "-");
+    CHECK_DIGI("LD9T", "-");
+
+    /* Used */
+    CHECK_DIGI("RELAY*", "-");
+    CHECK_DIGI("LA2XY*,LD9TS*", "-");
+}
+
+
+static void check_restart()
+{
+    uint8_t free = fbuf_freeSlots();
+
+    set_mode(true, false, false, false, 2);
+    SET_BYTE_PARAM(DIGI_VISCOUS, 5);
+    digipeater_init();
+    digipeater_activate(true);
+    CHECK(n_threads == 2 && host_rxq[1] == &rxqueue);
+    CHECK(!host_run(digipeater_thread));
+
+    /* Frame is held. The delay thread waits for its timer */
+    CHECK_DIGI("WIDE1-1", "-");
+    CHECK(h_count == 1);
+    CHECK(!host_run(delay_thread));
+    digipeater_activate(false);
+    CHECK(host_rxq[1] == NULL);
+
+    /* Restart must wait for both threads. The held frame is dropped */
+    digipeater_activate(true);
+    CHECK(n_joined == 2 && n_threads == 4);
+    CHECK(digi_on && host_rxq[1] == &rxqueue);
+    CHECK(h_count == 0 && fbq_eof(&txq));
+
+    /* The new digipeater thread gets the wake-up signal, an empty frame */
+    CHECK(!host_run(digipeater_thread));
+    CHECK(fbq_eof(&rxqueue));
+    CHECK(fbuf_freeSlots() == free);
+    SET_BYTE_PARAM(DIGI_VISCOUS, 0);
+}
+
+
+
+int main()
+{
+    __digilist_t aliases;
+    addr_t mycall;
+
+    FBQ_INIT(txq, HDLC_ENCODER_QUEUE_SIZE);
+    str2addr(&mycall, "LD9TS", false);
+    SET_PARAM(MYCALL, &mycall);
+    str2addr(&aliases[0], "RELAY", false);
+    str2addr(&aliases[1], "TEST-3", false);
+    SET_PARAM(DIGI_ALIASES, &aliases);
+    SET_BYTE_PARAM(NDIGI_ALIASES, 2);
+
+    check_wide1();
+    check_widen();
+    check_trace();
+    check_sar();
+    check_preempt();
+    check_alias();
+    check_restart();
+    CHECK(fbq_eof(&txq));
+
+    printf("%s\n", (host_failures == 0 ? "Ok" : "FAILED"));
+    return (host_failures == 0 ? 0 : 1);
+}
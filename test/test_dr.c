@@ -0,0 +1,183 @@
+/*
+ * Dead reckoning replay test.
+ *
+ * A vehicle track is generated at one fix per second: straight roads,
+ * turns, stops and speed changes, at different latitudes. From each fix,
+ * the position is extrapolated over gaps of up to a minute and compared
+ * with the true position later on the track. With constant speed and
+ * course, the estimate must be close to the true position.
+ *
+ * The returned radius assumes that the velocity changes by at most
+ * 1 m/s plus 10% of the speed. Random velocity changes within that must
+ * keep the true position within the radius. On the generated track,
+ * with corners and larger speed changes, the share within the radius
+ * is only reported.
+ */
+
+#include "../gps.c"
+#include "host.h"
+#include <stdlib.h>
+
+#define TRACK_LEN  3600
+#define MAX_GAP    60
+
+
+
+static posdata_t track[TRACK_LEN];
+static bool straight[TRACK_LEN];    /* Constant speed and course from here */
+
+
+
+/*************************************************************************
+ * Generate track with exact formulas
+ *************************************************************************/
+
+static void move(double* lat, double* lon, double dist, double crs)
+{
+    double r = dist / EARTH_RADIUS_IN_METERS, a = crs * DEG_TO_RAD;
+    double la = *lat * DEG_TO_RAD, lo = *lon * DEG_TO_RAD;
+    double la2 = asin(sin(la) * cos(r) + cos(la) * sin(r) * cos(a));
+    *lon = (lo + atan2(sin(a) * sin(r) * cos(la), cos(r) - sin(la) * sin(la2))) / DEG_TO_RAD;
+    *lat = la2 / DEG_TO_RAD;
+}
+
+
+static void make_track(double lat, double lon)
+{
+    double speed = 0, crs = rand() % 360, target = 0, turn = 0;
+    int i, hold = 0, turning = 0;
+
+    for (i=0; i<TRACK_LEN; i++) {
+       /* Now and then change speed (m/s), stop or turn a corner */
+       if (--hold <= 0) {
+          hold = 20 + rand() % 160;
+          target = (rand() % 6 == 0 ? 0 : 5 + rand() % 25);
+       }
+       if (turning == 0 && speed > 0 && rand() % 60 == 0) {
+          turning = 5 + rand() % 20;
+          turn = (rand() % 2 ? 4.5 : -4.5);
+       }
+       straight[i] = (speed == target && turning == 0);
+       track[i].latitude = lround(lat * 1e7);
+       track[i].longitude = lround(lon * 1e7);
+       track[i].speed = lround(speed / 0.5144 * 100);
+       track[i].course = ((int) lround(crs) + 360) % 360;
+       track[i].timestamp = i;
+       track[i].altitude = -1;
+
+       move(&lat, &lon, speed, crs);
+       if (turning > 0) {
+          crs = fmod(crs + turn + 360, 360);
+          turning--;
+       }
+       speed = (speed < target ? fmin(speed + 1, target) : fmax(speed - 2, target));
+    }
+}
+
+
+/* Random velocity change within the assumptions of the radius */
+static void wobble(double* speed, double* crs, double v)
+{
+    double dv = (1 + 0.1 * v) * 0.95 * (rand() % 1000) / 1000.0;
+    double a = (rand() % 360) * DEG_TO_RAD;
+    double n = v + dv * cos(a), e = dv * sin(a);
+    *speed = sqrt(n * n + e * e);
+    *crs = atan2(e, n) / DEG_TO_RAD;
+}
+
+
+/* The track is straight between fix i and i+gap */
+static bool is_straight(int i, int gap)
+{
+    while (gap-- > 0)
+       if (!straight[i++])
+          return false;
+    return true;
+}
+
+
+
+int main()
+{
+    static const double lat[] = { 0, 35, -60, 78 };
+    int i, k, n, gap, n_straight = 0, n_all = 0, n_cover = 0;
+    uint32_t err, max_err = 0, d, max_diff = 0;
+    uint16_t r, b;
+    posdata_t est, pos;
+    double t0, la, lo, v, speed, crs;
+
+    srand(1);
+    for (n=0; n<4; n++) {
+       make_track(lat[n], 10.5);
+       for (i=0; i<TRACK_LEN - MAX_GAP; i++)
+          for (gap = 1; gap <= MAX_GAP; gap++) {
+             if (track[i].speed == 0)
+                continue;
+             r = gps_dead_reckon(&track[i], gap, &est);
+             CHECK(est.timestamp == track[i + gap].timestamp);
+             err = exact_distance(&est, &track[i + gap]);
+             n_all++;
+             n_cover += (err <= r);
+
+             if (is_straight(i, gap)) {
+                /* Error from rounding of speed and course */
+                n_straight++;
+                if (err > max_err)
+                   max_err = err;
+                CHECK(err <= 2 + exact_distance(&track[i], &track[i + gap]) / 50);
+
+                /* Distance and bearing of estimate */
+                d = exact_distance(&track[i], &est);
+                d = labs((long) d - (long) lround(track[i].speed * 0.005144 * gap));
+                if (d > max_diff)
+                   max_diff = d;
+                CHECK(d <= 1 + gap / 20);
+                if (exact_distance(&track[i], &est) >= 20) {
+                   b = gps_bearing(&track[i], &est);
+                   CHECK(abs((int) b - track[i].course) <= 1 || abs((int) b - track[i].course) >= 359);
+                }
+             }
+          }
+    }
+    printf("Constant course and speed: %d estimates, max error %u m, distance error %u m\n",
+       n_straight, max_err, max_diff);
+    printf("Whole track: %d estimates, %.1f%% within radius\n", n_all, 100.0 * n_cover / n_all);
+    CHECK(n_straight > 0);
+
+    /* Velocity changes within the radius assumptions */
+    n_all = n_cover = 0;
+    for (i=0; i<TRACK_LEN - MAX_GAP; i++) {
+       if (track[i].speed == 0)
+          continue;
+       v = track[i].speed * 0.005144;
+       for (gap = 1; gap <= MAX_GAP; gap++) {
+          r = gps_dead_reckon(&track[i], gap, &est);
+          la = track[i].latitude / 1e7;
+          lo = track[i].longitude / 1e7;
+          for (k=0; k<gap; k++) {
+             wobble(&speed, &crs, v);
+             move(&la, &lo, speed, track[i].course + crs);
+          }
+          pos.latitude = lround(la * 1e7);
+          pos.longitude = lround(lo * 1e7);
+          n_all++;
+          n_cover += (exact_distance(&est, &pos) <= r);
+       }
+    }
+    printf("Velocity within assumptions: %d estimates, %d outside radius\n", n_all, n_all - n_cover);
+    CHECK(n_cover == n_all);
+
+    /* Extrapolation is limited */
+    track[0].speed = 10000;
+    gps_dead_reckon(&track[0], 3600, &est);
+    CHECK(exact_distance(&track[0], &est) <= DR_LIMIT / 10 + 1);
+
+    t0 = host_time();
+    for (n=0; n<100; n++)
+       for (i=0; i<TRACK_LEN; i++)
+          gps_dead_reckon(&track[i], 30, &est);
+    printf("gps_dead_reckon: %.0f ns\n", (host_time() - t0) * 1e9 / (100 * TRACK_LEN));
+
+    printf("%s\n", (host_failures == 0 ? "Ok" : "FAILED"));
+    return (host_failures == 0 ? 0 : 1);
+}
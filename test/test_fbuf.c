@@ -0,0 +1,74 @@
+/*
+ * Buffer chain test: Removing the last bytes.
+ *
+ * The HDLC decoder removes the FCS from received frames with
+ * fbuf_removeLast(). The length of the buffer must drop by one for each
+ * byte removed, also when the last slot becomes empty and is freed.
+ * Writing must then continue right after the remaining bytes.
+ */
+
+#include "defines.h"
+#include "fbuf.h"
+#include "host.h"
+
+#define MAX_LEN  (3 * FBUF_SLOTSIZE)
+
+
+
+/* Buffer holds the first n bytes of data */
+static bool has_bytes(FBUF* b, const char* data, uint8_t n)
+{
+    uint8_t i;
+
+    if (fbuf_length(b) != n)
+       return false;
+    fbuf_reset(b);
+    for (i=0; i<n; i++)
+       if (fbuf_getChar(b) != data[i])
+          return false;
+    return true;
+}
+
+
+
+int main()
+{
+    char data[MAX_LEN + 1];
+    uint8_t n, free;
+    FBUF b;
+
+    for (n=0; n<MAX_LEN; n++)
+       data[n] = 'A' + n % 26;
+    free = fbuf_freeSlots();
+
+    /* Every length, so that the last bytes are at every position of a slot */
+    for (n=2; n<=MAX_LEN; n++) {
+       fbuf_new(&b);
+       fbuf_write(&b, data, n);
+       fbuf_removeLast(&b);
+       fbuf_removeLast(&b);
+       CHECK(has_bytes(&b, data, n-2));
+       CHECK(fbuf_freeSlots() == free - (n > 2 ? (n-3) / FBUF_SLOTSIZE + 1 : 1));
+
+       /* Write after the remaining bytes */
+       fbuf_putChar(&b, '*');
+       data[n-2] = '*';
+       CHECK(has_bytes(&b, data, n-1));
+       data[n-2] = 'A' + (n-2) % 26;
+       fbuf_release(&b);
+       CHECK(fbuf_freeSlots() == free);
+    }
+
+    /* Across a slot boundary */
+    fbuf_new(&b);
+    fbuf_write(&b, data, FBUF_SLOTSIZE + 1);
+    CHECK(fbuf_freeSlots() == free - 2);
+    fbuf_removeLast(&b);
+    fbuf_removeLast(&b);
+    CHECK(fbuf_length(&b) == FBUF_SLOTSIZE - 1);
+    CHECK(fbuf_freeSlots() == free - 1);
+    fbuf_release(&b);
+
+    printf("%s\n", (host_failures == 0 ? "Ok" : "FAILED"));
+    return (host_failures == 0 ? 0 : 1);
+}
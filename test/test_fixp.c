@@ -0,0 +1,182 @@
+/*
+ * Fixed-point position encoding, validated against floating point.
+ *
+ * The APRS encoders in the tracker work on integer positions (1e-7
+ * degrees), speeds (1/100 knots) and altitudes (1/10 m). The results are
+ * compared with the floating point formulas they replaced, over random
+ * positions and the full range of speeds and altitudes.
+ */
+
+#include "../tracker.c"
+#include "host.h"
+#include <stdlib.h>
+#include <math.h>
+
+#define N_POS  200000
+
+/* The GPS module is not included */
+posdata_t current_pos, filtered_pos;
+
+uint32_t gps_distance(posdata_t* a, posdata_t* b) { return 0; }
+uint16_t gps_bearing(posdata_t* a, posdata_t* b) { return 0; }
+uint16_t gps_dead_reckon(posdata_t* a, uint16_t s, posdata_t* b) { return 0; }
+uint16_t gps_fix_age() { return 0; }
+bool gps_is_fixed() { return true; }
+bool gps_wait_fix(uint16_t t) { return true; }
+void gps_on() {}
+void gps_off() {}
+void gps_standby() {}
+uint16_t gps_fix_time(uint16_t t) { return 0; }
+void gps_count_report() {}
+
+
+
+/*************************************************************************
+ * Float reference, as in the previous version of the tracker
+ *************************************************************************/
+
+static void ref_latlong(char* buf, double pos, bool is_longitude)
+{
+    double f = fabs(pos);
+    int deg = (int) f;
+    char min[8];
+
+    sprintf(min, "%05.2f", (f - deg) * 60);
+    if (strcmp(min, "60.00") == 0) {
+       deg++;
+       strcpy(min, "00.00");
+    }
+    if (is_longitude)
+       sprintf(buf, "%03d%s%c", deg, min, (pos < 0 ? 'W' : 'E'));
+    else
+       sprintf(buf, "%02d%s%c", deg, min, (pos < 0 ? 'S' : 'N'));
+}
+
+
+static uint32_t ref_compressed(double pos, bool is_longitude)
+   { return (uint32_t) (is_longitude ? 190463 * (180+pos) : 380926 * (90-pos)); }
+
+
+
+/*************************************************************************
+ * Read back what the encoders put in a frame
+ *************************************************************************/
+
+static uint32_t get_base91(FBUF* b, uint8_t n)
+{
+    uint32_t v = 0;
+    fbuf_reset(b);
+    while (n-- > 0)
+       v = v * 91 + (fbuf_getChar(b) - ASCII_BASE);
+    return v;
+}
+
+
+static uint8_t get_char(FBUF* b, uint8_t i)
+{
+    fbuf_reset(b);
+    while (i-- > 0)
+       fbuf_getChar(b);
+    return fbuf_getChar(b);
+}
+
+
+static int32_t rand_pos(int32_t max)
+   { return (int32_t) (((int64_t) rand() << 16 ^ rand()) % (2LL * max + 1) - max); }
+
+
+
+static void check_latlong()
+{
+    char buf[16], ref[16];
+    int32_t lat, lon;
+    int i, n_tie = 0;
+    FBUF f;
+
+    for (i=0; i<N_POS; i++) {
+       lat = (i < 4 ? (i & 1 ? -1 : 1) * (i & 2 ? 899999999 : 0) : rand_pos(900000000));
+       lon = (i < 4 ? (i & 1 ? -1 : 1) * (i & 2 ? 1799999999 : 0) : rand_pos(1800000000));
+
+       /* ddmm.mm. An exact tie between two 1/100 minutes may round either way */
+       send_latlong(buf, lat, false);
+       ref_latlong(ref, lat / 1e7, false);
+       if (labs(lat) % 10000000 * 6 % 10000 == 5000)
+          n_tie++;
+       else
+          CHECK(strcmp(buf, ref) == 0);
+       send_latlong(buf, lon, true);
+       ref_latlong(ref, lon / 1e7, true);
+       if (labs(lon) % 10000000 * 6 % 10000 != 5000)
+          CHECK(strcmp(buf, ref) == 0);
+
+       /* Compressed, within one of the last base 91 digit */
+       fbuf_new(&f);
+       send_latlong_compressed(&f, lat, false);
+       CHECK(llabs((int64_t) get_base91(&f, 4) - ref_compressed(lat / 1e7, false)) <= 1);
+       fbuf_release(&f);
+       fbuf_new(&f);
+       send_latlong_compressed(&f, lon, true);
+       CHECK(llabs((int64_t) get_base91(&f, 4) - ref_compressed(lon / 1e7, true)) <= 1);
+       fbuf_release(&f);
+    }
+    printf("%d positions, %d rounding ties\n", N_POS, n_tie);
+}
+
+
+
+static void check_speed_alt()
+{
+    posdata_t pos;
+    int32_t d, max_d = 0;
+    uint16_t s;
+    int32_t a;
+    char buf[16];
+    FBUF f;
+
+    memset(&pos, 0, sizeof(pos));
+
+    /* Compressed speed, 0 to 600 knots */
+    pos.altitude = -1;
+    for (s = 0; s <= 60000; s++) {
+       pos.speed = s;
+       fbuf_new(&f);
+       send_csT_compressed(&f, &pos);
+       d = get_char(&f, 1) - ASCII_BASE - (int32_t) (log(s / 100.0 + 1) / 0.076961);
+       fbuf_release(&f);
+       CHECK(labs(d) <= 1);
+       if (labs(d) > max_d)
+          max_d = labs(d);
+    }
+    printf("Compressed speed: max error %d\n", max_d);
+
+    /* Compressed and uncompressed altitude, 0 to 10000 m. Zero below one foot */
+    SET_BYTE_PARAM(ALTITUDE_ON, 1);
+    max_d = 0;
+    for (a = 0; a <= 100000; a++) {
+       pos.altitude = a;
+       fbuf_new(&f);
+       send_csT_compressed(&f, &pos);
+       d = get_base91(&f, 2) -
+          (a / 10.0 * FEET2M < 1 ? 0 : (int32_t) (log(a / 10.0 * FEET2M) / 0.001998));
+       fbuf_release(&f);
+       CHECK(labs(d) <= 1);
+       if (labs(d) > max_d)
+          max_d = labs(d);
+
+       sprintf(buf, "%06lu", (unsigned long) ALT2FEET(a));
+       CHECK(atol(buf) == (long) round(a / 10.0 * FEET2M));
+    }
+    printf("Compressed altitude: max error %d\n", max_d);
+}
+
+
+
+int main()
+{
+    srand(1);
+    check_latlong();
+    check_speed_alt();
+
+    printf("%s\n", (host_failures == 0 ? "Ok" : "FAILED"));
+    return (host_failures == 0 ? 0 : 1);
+}
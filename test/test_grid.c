@@ -0,0 +1,108 @@
+/*
+ * Fast distance and bearing, compared with the haversine and atan2
+ * formulas over a global grid, and timed.
+ *
+ * From each grid point, vectors in 64 directions up to about 25 km are
+ * used. That is within and just beyond the limit of the fast method.
+ */
+
+#include "../gps.c"
+#include "host.h"
+#include <stdlib.h>
+
+#define N_DIR       64
+#define BENCH_RUNS  20
+
+/* Required accuracy. Bearing is only checked beyond MIN_DIST meters */
+#define MAX_ABS_ERR  1
+#define MAX_BRG_ERR  1
+#define MIN_DIST     20
+
+
+#define N_PAIRS  (35 * 36 * N_DIR)
+
+static posdata_t from[N_PAIRS], to[N_PAIRS];
+static int n_pairs = 0;
+
+
+static void make_grid()
+{
+    int lat, lon, k;
+    double ang, r;
+    posdata_t *a, *b;
+
+    for (lat = -85; lat <= 85; lat += 5)
+       for (lon = -175; lon <= 175; lon += 10)
+          for (k = 0; k < N_DIR; k++) {
+             a = &from[n_pairs];
+             b = &to[n_pairs++];
+             memset(a, 0, sizeof(posdata_t));
+             a->latitude = lat * 10000000L + k * 7919L;
+             a->longitude = lon * 10000000L + k * 104729L;
+             ang = k * 2 * M_PI / N_DIR;
+             r = (k % 8 + 1) * 4000;
+             *b = *a;
+             b->latitude += (int32_t) (r * cos(ang));
+             b->longitude += (int32_t) (r * 8 * sin(ang));
+          }
+}
+
+
+
+int main()
+{
+    int i, k, db, max_brg = 0, n_fast = 0;
+    uint32_t e, max_abs = 0;
+    double rel, max_rel = 0, t0, t_fast, t_exact;
+    int32_t dn, de;
+    volatile uint32_t sink = 0;
+
+    make_grid();
+    for (i=0; i<n_pairs; i++) {
+       uint32_t fd = gps_distance(&from[i], &to[i]);
+       e = exact_distance(&from[i], &to[i]);
+       n_fast += fast_vector(&from[i], &to[i], &dn, &de);
+       if ((fd > e ? fd - e : e - fd) > max_abs)
+          max_abs = (fd > e ? fd - e : e - fd);
+       if (e > MIN_DIST) {
+          rel = fabs((double) fd - e) / e;
+          if (rel > max_rel)
+             max_rel = rel;
+          db = abs((int) gps_bearing(&from[i], &to[i]) - (int) exact_bearing(&from[i], &to[i]));
+          if (db > 180)
+             db = 360 - db;
+          if (db > max_brg)
+             max_brg = db;
+       }
+    }
+    printf("%d pairs, %d by the fast method\n", n_pairs, n_fast);
+    printf("Max error: %u m, %.4f%% of distance, %d deg bearing\n", max_abs, max_rel * 100, max_brg);
+    CHECK(n_fast > n_pairs / 2);
+    CHECK(max_abs <= MAX_ABS_ERR);
+    CHECK(max_brg <= MAX_BRG_ERR);
+
+    /* Same position: No bearing */
+    CHECK(gps_distance(&from[0], &from[0]) == 0);
+    CHECK(gps_bearing(&from[0], &from[0]) == (uint16_t) -1);
+
+    /* Timing of the positions within reach of the fast method */
+    t0 = host_time();
+    for (k=0; k<BENCH_RUNS; k++)
+       for (i=0; i<n_pairs; i++)
+          if (fast_vector(&from[i], &to[i], &dn, &de))
+             sink += gps_distance(&from[i], &to[i]) + gps_bearing(&from[i], &to[i]);
+    t_fast = host_time() - t0;
+
+    t0 = host_time();
+    for (k=0; k<BENCH_RUNS; k++)
+       for (i=0; i<n_pairs; i++)
+          if (fast_vector(&from[i], &to[i], &dn, &de))
+             sink += exact_distance(&from[i], &to[i]) + exact_bearing(&from[i], &to[i]);
+    t_exact = host_time() - t0;
+
+    printf("Distance + bearing: fast %.0f ns, exact %.0f ns\n",
+       t_fast * 1e9 / (n_fast * BENCH_RUNS), t_exact * 1e9 / (n_fast * BENCH_RUNS));
+
+    printf("%s\n", (host_failures == 0 ? "Ok" : "FAILED"));
+    return (host_failures == 0 ? 0 : 1);
+}
@@ -0,0 +1,302 @@
+/*
+ * HDLC decoder duplicate check hash test.
+ *
+ * AX.25 frames are HDLC encoded (with bit stuffing, flags and FCS) and
+ * fed to the decoder thread. The hash it computes while receiving must
+ * cover the destination and source callsigns and SSIDs and the
+ * information field, and nothing else: Copies of a frame with other
+ * command/response and H-bits, another digipeater path and thus another
+ * FCS must hash equal, and frames that differ only in the information
+ * field must not. Paths of 0 to 7 digipeaters exercise the path skip,
+ * and short information fields the holding back of the last two octets
+ * (the FCS). Each subscriber must get the hash with its reference to
+ * the frame.
+ */
+
+#include "../hdlc_decoder.c"
+#include "host.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define N_RANDOM   2000
+#define MAX_INFO   80
+
+static Stream bits_in;
+static FBQ q1, q2;
+
+void chanstat_frame(uint16_t len) {}
+
+
+
+/*************************************************************************
+ * AX.25 frames
+ *************************************************************************/
+
+typedef struct {
+    char call[2][7];          /* Destination and source, 6 chars and SSID */
+    uint8_t cr[2];            /* Command/response bits */
+    uint8_t ndigis;
+    char digi[7][7];
+    bool h[7];
+    uint8_t info[MAX_INFO];
+    uint8_t ilen;
+} frame_t;
+
+
+static void put_addr(uint8_t* b, const char* call, uint8_t bit7, bool last)
+{
+    uint8_t i;
+    for (i=0; i<6; i++)
+       b[i] = call[i] << 1;
+    b[6] = bit7 | 0x60 | (call[6] & 0x0f) << 1 | (last ? FLAG_LAST : 0);
+}
+
+
+/* Frame without FCS. Return length */
+static uint16_t encode(const frame_t* f, uint8_t* b)
+{
+    uint16_t n = 0;
+    uint8_t i;
+
+    put_addr(b, f->call[0], f->cr[0], false);
+    put_addr(b + 7, f->call[1], f->cr[1], f->ndigis == 0);
+    n = 14;
+    for (i=0; i<f->ndigis; i++, n += 7)
+       put_addr(b + n, f->digi[i], (f->h[i] ? FLAG_DIGI : 0), i == f->ndigis - 1);
+    b[n++] = FTYPE_UI;
+    b[n++] = PID_NO_L3;
+    memcpy(b + n, f->info, f->ilen);
+    return n + f->ilen;
+}
+
+
+/* The hash as it is defined */
+static uint16_t ref_hash(const frame_t* f)
+{
+    uint16_t h = 0xffff;
+    uint8_t i, k;
+    for (k=0; k<2; k++) {
+       for (i=0; i<6; i++)
+          h = _crc_ccitt_update(h, f->call[k][i] << 1);
+       h = _crc_ccitt_update(h, f->call[k][6] & 0x0f);
+    }
+    for (i=0; i<f->ilen; i++)
+       h = _crc_ccitt_update(h, f->info[i]);
+    return h;
+}
+
+
+static void random_call(char* c)
+{
+    uint8_t i, n = 3 + rand() % 4;
+    for (i=0; i<6; i++)
+       c[i] = (i < n ? (i == 2 ? '0' + rand() % 10 : 'A' + rand() % 26) : ' ');
+    c[6] = rand() % 16;
+}
+
+
+static void random_frame(frame_t* f)
+{
+    uint8_t i;
+    random_call(f->call[0]);
+    random_call(f->call[1]);
+    f->cr[0] = FLAG_CMD;
+    f->cr[1] = 0;
+    f->ndigis = 0;
+    f->ilen = rand() % (MAX_INFO + 1);
+    for (i=0; i<f->ilen; i++)                  /* Many ones, for bit stuffing */
+       f->info[i] = (rand() % 4 == 0 ? 0x7e : rand() % 4 == 0 ? 0xff : rand());
+}
+
+
+/* Same frame with other path of n digipeaters, and control bits */
+static void random_path(frame_t* f, uint8_t n)
+{
+    uint8_t i;
+    f->cr[0] = (rand() % 2 ? FLAG_CMD : 0);
+    f->cr[1] = (rand() % 2 ? FLAG_CMD : 0);
+    f->ndigis = n;
+    for (i=0; i<f->ndigis; i++) {
+       random_call(f->digi[i]);
+       f->h[i] = rand() % 2;
+    }
+}
+
+
+
+/*************************************************************************
+ * HDLC bit stream to the decoder. Bits are sent LSB first.
+ *************************************************************************/
+
+static uint8_t out_byte, out_bits, ones;
+
+static void put_bit(uint8_t bit)
+{
+    out_byte |= bit << out_bits;
+    if (++out_bits == 8) {
+       stream_put(&bits_in, out_byte);
+       out_byte = out_bits = 0;
+    }
+}
+
+static void put_flag()
+{
+    uint8_t i;
+    for (i=0; i<8; i++)
+       put_bit((HDLC_FLAG >> i) & 1);
+    ones = 0;
+}
+
+static void put_octet(uint8_t c)
+{
+    uint8_t i, bit;
+    for (i=0; i<8; i++) {
+       bit = (c >> i) & 1;
+       put_bit(bit);
+       ones = (bit ? ones + 1 : 0);
+       if (ones == 5) {
+          put_bit(0);
+          ones = 0;
+       }
+    }
+}
+
+
+/*
+ * Send frame to the decoder and return the buffers the two subscribers
+ * get. The decoder runs until it waits for more bits.
+ */
+static void send(const frame_t* f, FBUF* r1, FBUF* r2)
+{
+    uint8_t b[AX25_HDR_LEN(7) + MAX_INFO];
+    uint16_t n = encode(f, b), i, crc = 0xffff;
+
+    put_flag();
+    put_flag();
+    for (i=0; i<n; i++) {
+       crc = _crc_ccitt_update(crc, b[i]);
+       put_octet(b[i]);
+    }
+    put_octet(crc ^ 0xff);
+    put_octet((crc >> 8) ^ 0xff);
+    put_flag();
+    put_flag();
+    while (out_bits > 0)
+       put_bit(0);
+    host_run(hdlc_decode);
+
+    CHECK(!fbq_eof(&q1) && !fbq_eof(&q2));
+    *r1 = fbq_get(&q1);
+    *r2 = fbq_get(&q2);
+    CHECK(fbq_eof(&q1) && fbq_eof(&q2));
+
+    /* The frame without the FCS */
+    CHECK(fbuf_length(r1) == n);
+    fbuf_reset(r1);
+    for (i=0; i<n && fbuf_getChar(r1) == b[i]; i++)
+       ;
+    CHECK(i == n);
+}
+
+
+/* Hash of frame. Both subscribers must get the same */
+static uint16_t hash_of(const frame_t* f)
+{
+    FBUF r1, r2;
+    uint16_t h;
+
+    send(f, &r1, &r2);
+    h = r1.hash;
+    CHECK(r2.hash == h);
+    fbuf_release(&r1);
+    fbuf_release(&r2);
+    return h;
+}
+
+
+
+/*************************************************************************
+ * Tests
+ *************************************************************************/
+
+/* Copies with other paths hash equal, and as defined */
+static void check_copies(frame_t* f)
+{
+    uint16_t h = hash_of(f), r = ref_hash(f);
+    uint8_t k;
+
+    CHECK(h == r);
+    for (k=0; k<8; k++) {
+       random_path(f, rand() % 8);
+       CHECK(hash_of(f) == h);
+    }
+}
+
+
+/* Frames with another information field hash differently */
+static void check_payload(frame_t* f)
+{
+    uint16_t h = hash_of(f);
+    uint8_t i, c;
+
+    for (i=0; i<f->ilen; i++) {
+       c = f->info[i];
+       f->info[i] ^= 1 << (rand() % 8);
+       random_path(f, rand() % 8);
+       CHECK(hash_of(f) != h);
+       f->info[i] = c;
+    }
+    if (f->ilen < MAX_INFO) {
+       f->info[f->ilen++] = rand();
+       CHECK(hash_of(f) != h);
+       f->ilen--;
+    }
+    if (f->ilen > 0) {
+       f->ilen--;
+       CHECK(hash_of(f) != h);
+       f->ilen++;
+    }
+}
+
+
+int main()
+{
+    frame_t f;
+    uint8_t free;
+    int i, k;
+
+    STREAM_INIT(bits_in, 512);
+    FBQ_INIT(q1, HDLC_DECODER_QUEUE_SIZE);
+    FBQ_INIT(q2, HDLC_DECODER_QUEUE_SIZE);
+    hdlc_init_decoder(&bits_in);
+    hdlc_subscribe_rx(&q1, 1);
+    hdlc_subscribe_rx(&q2, 2);
+    srand(1);
+
+    /* Preamble: The decoder starts with its bit buffer full of ones */
+    for (i=0; i<4; i++)
+       put_flag();
+
+    /* Short information fields, where the FCS is held back from the
+     * start of the field, and every path length */
+    for (i=0; i<=4; i++)
+       for (k=0; k<8; k++) {
+          random_frame(&f);
+          f.ilen = i;
+          random_path(&f, k);
+          check_copies(&f);
+          check_payload(&f);
+       }
+
+    free = fbuf_freeSlots();
+    for (i=0; i<N_RANDOM; i++) {
+       random_frame(&f);
+       check_copies(&f);
+       if (i % 10 == 0)
+          check_payload(&f);
+    }
+    CHECK(fbuf_freeSlots() == free);
+
+    printf("%s\n", (host_failures == 0 ? "Ok" : "FAILED"));
+    return (host_failures == 0 ? 0 : 1);
+}
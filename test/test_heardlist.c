@@ -0,0 +1,181 @@
+/*
+ * Heard list test and benchmark.
+ *
+ * A frame checksum must be found for 29 to 30 seconds after it was added
+ * (the time has a resolution of one second), also when the time wraps
+ * around. Busy digipeater traffic is then replayed: new frames, and
+ * copies of frames heard up to 40 seconds earlier, as digipeated by
+ * other stations. Each lookup is compared with an exact reference.
+ * Frames must never be reported as heard when they were not, and copies
+ * within the window may only be missed when the list is overloaded.
+ * Lookup and add are timed, and compared with the previous version,
+ * a scan of a ring of the last HEARDLIST_SIZE frames.
+ */
+
+#include "../heardlist.c"
+#include "host.h"
+#include <stdlib.h>
+
+#define N_FRAMES     500000
+#define COPY_SHARE   4       /* Of 10 frames */
+#define MAX_BACK     40      /* Copies of frames up to this many seconds old */
+#define BENCH_RUNS   20
+
+static uint16_t sent_cs[N_FRAMES];                  /* New frames */
+static uint16_t frame_cs[N_FRAMES];                 /* All frames, and when heard */
+static uint32_t frame_t[N_FRAMES];
+static uint32_t ref_added[0x10000];   /* Seconds + 1 when added, 0 if never */
+
+
+
+/*************************************************************************
+ * Previous version, for comparison
+ *************************************************************************/
+
+static HItem old_list[HEARDLIST_SIZE];
+static uint8_t old_next = 0;
+
+static bool old_exists(uint16_t x)
+{
+    uint8_t i;
+    for (i=0; i<HEARDLIST_SIZE; i++)
+       if (old_list[i].val == x)
+          return true;
+    return false;
+}
+
+static void old_add(uint16_t x)
+{
+    old_list[old_next].val = x;
+    old_list[old_next].exp = now();
+    old_next = (old_next + 1) % HEARDLIST_SIZE;
+}
+
+
+
+/*************************************************************************
+ * Dupe window
+ *************************************************************************/
+
+static void check_window()
+{
+    uint16_t x, k;
+    uint32_t t;
+    int i;
+
+    for (i=0; i<1000; i++) {
+       /* Any time within a second, also where the time wraps around */
+       t = (i < 500 ? rand() % 1000000 : 65536L * TIMER_RESOLUTION - rand() % 5000);
+       x = rand();
+       host_ticks = t;
+       CHECK(!hlist_exists(x));
+       hlist_add(x);
+       CHECK(hlist_exists(x));
+       host_ticks = t + 29 * TIMER_RESOLUTION - 1;
+       CHECK(hlist_exists(x));
+       host_ticks = t + 30 * TIMER_RESOLUTION;
+       CHECK(!hlist_exists(x));
+    }
+
+    /* Full probe sequence: The entry that expires first is replaced */
+    memset(hlist, 0, sizeof(hlist));
+    for (k=1; k<=HEARDLIST_PROBES + 1; k++) {
+       host_ticks = k * TIMER_RESOLUTION;
+       hlist_add(k * 0x101);     /* Same home slot */
+    }
+    CHECK(!hlist_exists(0x101));
+    for (k=2; k<=HEARDLIST_PROBES + 1; k++)
+       CHECK(hlist_exists(k * 0x101));
+}
+
+
+
+/*************************************************************************
+ * Busy digipeater traffic, compared with exact reference
+ *************************************************************************/
+
+static bool ref_exists(uint16_t x, uint32_t s)
+   { return ref_added[x] > 0 && s + 1 - ref_added[x] < HEARDLIST_MAX_AGE; }
+
+
+static void replay(double rate)
+{
+    long n = 0, k, dupes = 0, missed = 0, false_dupes = 0;
+    uint32_t s;
+    uint16_t cs;
+    bool heard, ref;
+
+    memset(hlist, 0, sizeof(hlist));
+    memset(ref_added, 0, sizeof(ref_added));
+    for (k=0; k<N_FRAMES; k++) {
+       host_ticks = 100000 + (uint32_t) (k * TIMER_RESOLUTION / rate);
+       s = host_ticks / TIMER_RESOLUTION;
+       if (n > MAX_BACK * rate && rand() % 10 < COPY_SHARE)
+          cs = sent_cs[n - 1 - rand() % (int) (MAX_BACK * rate)];
+       else {
+          cs = rand();
+          sent_cs[n++] = cs;
+       }
+       frame_cs[k] = cs;
+       frame_t[k] = host_ticks;
+       heard = hlist_exists(cs);
+       ref = ref_exists(cs, s);
+       dupes += ref;
+       missed += (ref && !heard);
+       false_dupes += (heard && !ref);
+       if (!heard) {
+          hlist_add(cs);
+          ref_added[cs] = s + 1;
+       }
+    }
+    printf("%4.1f frames/s: %ld dupes, %ld missed (%.3f%%), %ld frames falsely reported as dupes\n",
+       rate, dupes, missed, 100.0 * missed / dupes, false_dupes);
+    CHECK(false_dupes == 0);
+
+    /* A 1200 baud channel carries at most about one frame per second */
+    if (rate <= 1)
+       CHECK(missed * 1000 < dupes);
+}
+
+
+
+int main()
+{
+    int i, k;
+    double t0, t_new, t_old;
+    volatile int sink = 0;
+
+    srand(1);
+    check_window();
+    replay(0.5);
+    replay(1);
+    replay(2);
+
+    /* Lookup of each frame at 2 frames/s, and add if not heard */
+    t0 = host_time();
+    for (k=0; k<BENCH_RUNS; k++)
+       for (i=0; i<N_FRAMES; i++) {
+          host_ticks = frame_t[i];
+          if (!hlist_exists(frame_cs[i]))
+             hlist_add(frame_cs[i]);
+          else
+             sink++;
+       }
+    t_new = host_time() - t0;
+
+    t0 = host_time();
+    for (k=0; k<BENCH_RUNS; k++)
+       for (i=0; i<N_FRAMES; i++) {
+          host_ticks = frame_t[i];
+          if (!old_exists(frame_cs[i]))
+             old_add(frame_cs[i]);
+          else
+             sink++;
+       }
+    t_old = host_time() - t0;
+    printf("Lookup and add: %.1f ns, previous version %.1f ns\n",
+       t_new * 1e9 / (BENCH_RUNS * N_FRAMES), t_old * 1e9 / (BENCH_RUNS * N_FRAMES));
+
+    printf("%s\n", (host_failures == 0 ? "Ok" : "FAILED"));
+    return (host_failures == 0 ? 0 : 1);
+}
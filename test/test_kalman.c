@@ -0,0 +1,168 @@
+/*
+ * Kalman filter replay benchmark.
+ *
+ * A track is generated at one fix per second: standing still, walking
+ * and driving with corners. GPS noise is added to the position, speed
+ * and course. The track is replayed through the tracker's beaconing
+ * decision twice: with the raw GPS positions, as before the filter,
+ * and with the filtered positions. Reports sent, position and course
+ * errors are compared, and the time per filter update is measured.
+ */
+
+#include "../gps.c"
+#include "../tracker.c"
+#include "host.h"
+#include <stdlib.h>
+
+#define TRACK_LEN   3600
+#define POS_NOISE   3.0      /* Meters */
+#define VEL_NOISE   0.3      /* m/s */
+#define BENCH_RUNS  100
+
+
+static posdata_t truth[TRACK_LEN], gps[TRACK_LEN];
+
+
+
+/*************************************************************************
+ * Track and GPS noise
+ *************************************************************************/
+
+static double gauss()
+{
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+
+static void set_pos(posdata_t* p, double lat, double lon, double v, double crs, int t)
+{
+    memset(p, 0, sizeof(posdata_t));
+    p->latitude = lround(lat * 1e7);
+    p->longitude = lround(lon * 1e7);
+    p->speed = lround(v / 0.5144 * 100);
+    p->course = ((int) lround(crs) + 360) % 360;
+    p->timestamp = 1000 + t;
+    p->altitude = -1;
+}
+
+
+/*
+ * Ten minutes each: Standing, walking, driving in town, standing,
+ * driving on a highway, walking. Now and then a turn of 30 to 90
+ * degrees, with at most 2 m/s^2 of lateral acceleration.
+ */
+static void make_track()
+{
+    static const double speed[] = { 0, 1.4, 12, 0, 27, 1.4 };
+    double lat = 60, lon = 10.5, v, crs = 0, n, e, vn, ve, turn = 0;
+    int i, turning = 0;
+
+    for (i=0; i<TRACK_LEN; i++) {
+       v = speed[i / 600];
+       if (turning == 0 && v > 0 && rand() % 40 == 0) {
+          turn = fmin(30, 2 / v / DEG_TO_RAD);
+          turning = lround((30 + rand() % 61) / turn);
+          turn = (rand() % 2 ? turn : -turn);
+       }
+       set_pos(&truth[i], lat, lon, v, crs, i);
+
+       /* Receiver position and velocity with noise */
+       n = POS_NOISE * gauss();
+       e = POS_NOISE * gauss();
+       vn = v * cos(crs * DEG_TO_RAD) + VEL_NOISE * gauss();
+       ve = v * sin(crs * DEG_TO_RAD) + VEL_NOISE * gauss();
+       set_pos(&gps[i], lat + n / 111195, lon + e / (111195 * cos(lat * DEG_TO_RAD)),
+          sqrt(vn * vn + ve * ve), atan2(ve, vn) / DEG_TO_RAD, i);
+
+       lat += v * cos(crs * DEG_TO_RAD) / 111195;
+       lon += v * sin(crs * DEG_TO_RAD) / (111195 * cos(lat * DEG_TO_RAD));
+       if (turning > 0) {
+          crs = fmod(crs + turn + 360, 360);
+          turning--;
+       }
+    }
+}
+
+
+
+/*************************************************************************
+ * Replay through should_update(), once per tracker period
+ *************************************************************************/
+
+static uint16_t replay(bool filter, uint32_t* max_err, double* rms_err, double* crs_err)
+{
+    uint8_t t = GET_BYTE_PARAM(TRACKER_SLEEP_TIME);
+    uint16_t n_reports = 0;
+    uint32_t err;
+    double sum = 0, sum_crs = 0;
+    posdata_t* pos;
+    int i, n = 0, n_crs = 0;
+
+    memset(&filtered_pos, 0, sizeof(posdata_t));
+    memset(&prev_pos, 0, sizeof(posdata_t));
+    memset(&prev_pos_gps, 0, sizeof(posdata_t));
+    course = prev_course = prev_gps_course = -1;
+    pause_count = 0;
+    maxpause_reached = waited = false;
+    *max_err = 0;
+
+    for (i=0; i<TRACK_LEN; i++) {
+       kf_update(&gps[i]);
+       pos = (filter ? &filtered_pos : &gps[i]);
+       err = exact_distance(pos, &truth[i]);
+       if (err > *max_err)
+          *max_err = err;
+       sum += (double) err * err;
+       n++;
+       if (truth[i].speed > 0) {
+          sum_crs += course_diff(pos->course, truth[i].course);
+          n_crs++;
+       }
+
+       if (i % t == 0) {
+          if (should_update(&prev_pos_gps, &prev_pos, pos)) {
+             n_reports++;
+             prev_pos = *pos;
+          }
+          prev_pos_gps = *pos;
+       }
+    }
+    *rms_err = sqrt(sum / n);
+    *crs_err = sum_crs / n_crs;
+    return n_reports;
+}
+
+
+
+int main()
+{
+    uint16_t n_raw, n_filt;
+    uint32_t max_raw, max_filt;
+    double rms_raw, rms_filt, crs_raw, crs_filt, t0;
+    int i, k;
+
+    srand(1);
+    make_track();
+
+    n_raw = replay(false, &max_raw, &rms_raw, &crs_raw);
+    n_filt = replay(true, &max_filt, &rms_filt, &crs_filt);
+    printf("Raw:      %u reports, position error max %u m, rms %.1f m, course error %.1f deg\n",
+       n_raw, max_raw, rms_raw, crs_raw);
+    printf("Filtered: %u reports, position error max %u m, rms %.1f m, course error %.1f deg\n",
+       n_filt, max_filt, rms_filt, crs_filt);
+
+    /* Not more reports, and the position and course must be better */
+    CHECK(n_filt <= n_raw);
+    CHECK(rms_filt < rms_raw && max_filt <= max_raw);
+    CHECK(crs_filt < crs_raw);
+
+    t0 = host_time();
+    for (k=0; k<BENCH_RUNS; k++)
+       for (i=0; i<TRACK_LEN; i++)
+          kf_update(&gps[i]);
+    printf("kf_update: %.0f ns\n", (host_time() - t0) * 1e9 / (BENCH_RUNS * TRACK_LEN));
+
+    printf("%s\n", (host_failures == 0 ? "Ok" : "FAILED"));
+    return (host_failures == 0 ? 0 : 1);
+}
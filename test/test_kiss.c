@@ -0,0 +1,129 @@
+/*
+ * KISS loopback test.
+ *
+ * KISS frames from the host are decoded by the tx thread and put on the
+ * encoder queue. The frames are looped back to the receive queue, and
+ * the rx thread must send exactly the same KISS encoding to the host.
+ * Also tests parameter commands, the return command and restarting.
+ */
+
+#include "../kiss.c"
+#include "host.h"
+
+static Stream host_in, host_out;
+static FBQ txq;
+fbq_t* outframes = &txq;
+
+static uint8_t n_threads = 0, n_joined = 0;
+
+void _t_start(void (*f)(void), TCB* tcb, uint16_t stsize)
+   { n_threads++; }
+
+
+/*
+ * kiss_activate waits for the threads of the previous session to
+ * terminate. Let them run when it sleeps.
+ */
+void sleep(uint16_t ticks)
+{
+    host_ticks += ticks;
+    if (rx_alive && host_run(kiss_rx_thread))
+       n_joined++;
+    if (tx_alive && host_run(kiss_tx_thread))
+       n_joined++;
+}
+
+
+/* AX.25 UI frame with bytes in the info field that need escaping */
+static const uint8_t frame[] = {
+    'A'<<1, 'P'<<1, 'R'<<1, 'S'<<1, ' '<<1, ' '<<1, 0x60,
+    'L'<<1, 'A'<<1, '7'<<1, 'E'<<1, 'C'<<1, 'A'<<1, 0x61,
+    0x03, 0xf0, '>', 'x', FEND, 'y', FESC, TFEND, FEND, 'z'
+};
+
+
+static void put_frame(Stream* s, uint8_t cmd, const uint8_t* data, uint8_t len)
+{
+    uint8_t i;
+    stream_put(s, FEND);
+    stream_put(s, cmd);
+    for (i=0; i<len; i++) {
+       if (data[i] == FEND) {
+          stream_put(s, FESC);
+          stream_put(s, TFEND);
+       }
+       else if (data[i] == FESC) {
+          stream_put(s, FESC);
+          stream_put(s, TFESC);
+       }
+       else
+          stream_put(s, data[i]);
+    }
+    stream_put(s, FEND);
+}
+
+
+static uint16_t get_all(Stream* s, uint8_t* buf)
+{
+    uint16_t n = 0;
+    while (!stream_empty(s))
+       buf[n++] = stream_get(s);
+    return n;
+}
+
+
+
+int main()
+{
+    uint8_t expect[128], got[128];
+    uint16_t n_expect, n_got;
+    uint8_t txdelay = 30;
+    FBUF f;
+
+    STREAM_INIT(host_in, 256);
+    STREAM_INIT(host_out, 256);
+    FBQ_INIT(txq, HDLC_ENCODER_QUEUE_SIZE);
+    kiss_init(&host_in, &host_out);
+    kiss_activate(true);
+    CHECK(kiss_is_on() && n_threads == 2 && host_rxq[2] == &kissq);
+
+    /* Host to radio. Only the data frame on port 0 is sent */
+    put_frame(&host_in, KISS_DATA, frame, sizeof(frame));
+    put_frame(&host_in, KISS_TXDELAY, &txdelay, 1);
+    put_frame(&host_in, 0x10, frame, sizeof(frame));
+    put_frame(&host_in, KISS_DATA, frame, AX25_HDR_LEN(0) - 1);
+    CHECK(!host_run(kiss_tx_thread));
+    CHECK(GET_BYTE_PARAM(TXDELAY) == KISS2FLAGS(txdelay));
+    CHECK(!fbq_eof(&txq));
+    f = fbq_get(&txq);
+    CHECK(fbq_eof(&txq));
+    CHECK(fbuf_length(&f) == sizeof(frame));
+    fbuf_reset(&f);
+    for (n_got = 0; !fbuf_eof(&f); n_got++)
+       got[n_got] = fbuf_getChar(&f);
+    CHECK(n_got == sizeof(frame) && memcmp(got, frame, sizeof(frame)) == 0);
+
+    /* Loop back. Host must get the same KISS encoding */
+    fbq_put(host_rxq[2], f);
+    CHECK(!host_run(kiss_rx_thread));
+    put_frame(&host_in, KISS_DATA, frame, sizeof(frame));
+    n_expect = get_all(&host_in, expect);
+    n_got = get_all(&host_out, got);
+    CHECK(n_got == n_expect && memcmp(got, expect, n_expect) == 0);
+
+    /* Return command ends KISS mode and the tx thread */
+    stream_put(&host_in, FEND);
+    stream_put(&host_in, KISS_RETURN);
+    stream_put(&host_in, FEND);
+    CHECK(host_run(kiss_tx_thread));
+    CHECK(!kiss_is_on() && !tx_alive && rx_alive);
+    CHECK(host_rxq[2] == NULL);
+
+    /* Restart must wait for the rx thread of the previous session */
+    kiss_activate(true);
+    CHECK(n_joined == 1 && n_threads == 4);
+    CHECK(kiss_is_on() && host_rxq[2] == &kissq);
+
+    printf("%s\n", (host_failures == 0 ? "Ok" : "FAILED"));
+    return (host_failures == 0 ? 0 : 1);
+}
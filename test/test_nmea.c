@@ -0,0 +1,248 @@
+/*
+ * NMEA parser corpus test and benchmark.
+ *
+ * The character driven parser is compared with a reference which
+ * works like the previous parser: Read a line, check the checksum,
+ * split it into fields and convert them with sscanf and floats.
+ * The corpus is recorded sentences plus generated RMC and GGA
+ * sentences in the formats of different receivers, with other
+ * sentences, bad checksums, truncated lines and noise in between.
+ */
+
+#include "../gps.c"
+#include "host.h"
+#include <stdlib.h>
+#include <stdarg.h>
+
+#define CORPUS_GEN  3000
+#define BENCH_RUNS  20
+
+static char* corpus[CORPUS_GEN * 3 + 32];
+static int n_corpus = 0;
+
+static const char* recorded[] = {
+    "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n",
+    "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n",
+    "$GPRMC,225446,A,4916.45,N,12311.12,W,000.5,054.7,191194,020.3,E*68\r\n",
+    "$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39\r\n",
+    "$GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45*75\r\n",
+    "$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48\r\n",
+    "$GPRMC,081836,A,3751.65,S,14507.36,E,000.0,360.0,130998,011.3,E*62\r\n",
+    "$GPRMC,235959,V,,,,,,,010100,,,N*74\r\n",
+    "$GPGGA,235959,,,,,0,00,99.99,,,,,,*6A\r\n",
+    "$GNRMC,101530.00,A,5957.50331,N,01045.43802,E,0.012,,051120,,,A*69\r\n",
+    "$GNGGA,101530.00,5957.50331,N,01045.43802,E,1,10,0.89,-12.3,M,39.5,M,,*4A\r\n",
+    "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6B\r\n",
+    "$GPRMC,0315\r\n",
+    "\x01\xb5\x62garbage\r\n",
+    NULL
+};
+
+
+
+/*************************************************************************
+ * Reference parser
+ *************************************************************************/
+
+typedef struct {
+    bool valid, rmc, gga;
+    uint32_t time;
+    uint8_t date;
+    char status;
+    double lat, lon, speed, course, alt;
+    int fix;
+} ref_t;
+
+
+static double ref_coord(const char* s, int ndeg)
+{
+    char deg[4] = {0};
+    double min = 0;
+    if (strlen(s) < ndeg)
+       return 0;
+    strncpy(deg, s, ndeg);
+    sscanf(s + ndeg, "%lf", &min);
+    return atoi(deg) + min / 60;
+}
+
+
+static bool ref_parse(const char* line, ref_t* r)
+{
+    char buf[100], *argv[20], *p;
+    int argc = 0, i;
+    unsigned int c_checksum;
+    uint8_t checksum = 0;
+
+    memset(r, 0, sizeof(ref_t));
+    if (line[0] != '$' || strlen(line) >= sizeof(buf))
+       return false;
+    strcpy(buf, line);
+    buf[strcspn(buf, "\r\n")] = 0;
+    for (i=1; buf[i] != '*' && buf[i] != 0; i++)
+       checksum ^= buf[i];
+    if (buf[i] == '*') {
+       buf[i] = 0;
+       if (sscanf(buf+i+1, "%2X", &c_checksum) != 1 || c_checksum != checksum)
+          return false;
+    }
+    for (p = buf; p != NULL && argc < 20; )
+       argv[argc++] = strsep(&p, ",");
+
+    r->rmc = (strncmp("RMC", argv[0]+3, 3) == 0);
+    r->gga = (strncmp("GGA", argv[0]+3, 3) == 0);
+    if (!(r->rmc || r->gga) || argc < 10)
+       return false;
+    r->valid = true;
+    if (r->rmc) {
+       r->time = atol(argv[1]);
+       r->status = argv[2][0];
+       r->lat = ref_coord(argv[3], 2) * (argv[4][0] == 'S' ? -1 : 1);
+       r->lon = ref_coord(argv[5], 3) * (argv[6][0] == 'W' ? -1 : 1);
+       sscanf(argv[7], "%lf", &r->speed);
+       sscanf(argv[8], "%lf", &r->course);
+       r->date = atol(argv[9]) / 10000;
+    }
+    else {
+       r->fix = atoi(argv[6]);
+       sscanf(argv[9], "%lf", &r->alt);
+    }
+    return true;
+}
+
+
+
+/*************************************************************************
+ * Corpus
+ *************************************************************************/
+
+static void add(const char* fmt, ...)
+{
+    char body[100], line[110];
+    uint8_t csum = 0;
+    va_list ap;
+    int i;
+
+    va_start(ap, fmt);
+    vsnprintf(body, sizeof(body), fmt, ap);
+    va_end(ap);
+    for (i=1; body[i] != 0; i++)
+       csum ^= body[i];
+    sprintf(line, "%s*%02X\r\n", body, csum);
+    corpus[n_corpus++] = strdup(line);
+}
+
+
+static void make_corpus()
+{
+    static const char* talker[] = { "GP", "GN" };
+    static const char* mfmt[] = { "%02d%07.4f", "%02d%08.5f", "%02d%05.2f" };
+    static const char* lfmt[] = { "%03d%07.4f", "%03d%08.5f", "%03d%05.2f" };
+    char lat[20], lon[20], spd[12], crs[12], tm[12];
+    int i, f;
+
+    for (i=0; recorded[i] != NULL; i++)
+       corpus[n_corpus++] = strdup(recorded[i]);
+
+    srand(1);
+    for (i=0; i<CORPUS_GEN; i++) {
+       const char* t = talker[rand() % 2];
+       double la = (rand() % 9000000) / 100000.0, lo = (rand() % 18000000) / 100000.0;
+       f = rand() % 3;
+       sprintf(lat, mfmt[f], (int) la, (la - (int) la) * 60);
+       sprintf(lon, lfmt[f], (int) lo, (lo - (int) lo) * 60);
+       if (strstr(lat, "60.0") || strstr(lon, "60.0"))
+          continue;
+       sprintf(spd, (rand() % 2 ? "%.1f" : "%.3f"), (rand() % 20000) / 100.0);
+       sprintf(crs, (rand() % 4 ? "%.1f" : ""), (rand() % 36000) / 100.0);
+       sprintf(tm, (rand() % 2 ? "%02d%02d%02d" : "%02d%02d%02d.00"),
+          rand() % 24, rand() % 60, rand() % 60);
+
+       add("$%sRMC,%s,%c,%s,%c,%s,%c,%s,%s,%02d%02d%02d,,,A", t, tm,
+          (rand() % 8 ? 'A' : 'V'), lat, (rand() % 2 ? 'N' : 'S'), lon,
+          (rand() % 2 ? 'E' : 'W'), spd, crs, rand() % 28 + 1, rand() % 12 + 1, rand() % 100);
+       add("$%sGGA,%s,%s,N,%s,E,%d,08,0.9,%.1f,M,46.9,M,,", t, tm, lat, lon,
+          rand() % 3, (rand() % 50000) / 10.0 - 100);
+       if (rand() % 4 == 0)
+          add("$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00");
+       if (rand() % 20 == 0) {
+          /* Corrupted sentence */
+          add("$GPRMC,%s,A,%s,N,%s,E,%s,%s,010120,,,A", tm, lat, lon, spd, crs);
+          corpus[n_corpus-1][10] ^= 0x01;
+       }
+    }
+}
+
+
+
+/*************************************************************************
+ * Feed sentences to the parser and compare with the reference
+ *************************************************************************/
+
+static void feed(const char* s)
+{
+    while (*s != 0)
+       nmea_char(*s++);
+}
+
+
+static void check_line(const char* line)
+{
+    ref_t r;
+    bool valid = ref_parse(line, &r);
+
+    nmea_ok = false;
+    feed(line);
+    if (nmea_ok != valid)
+       printf("%s", line);
+    CHECK(nmea_ok == valid);
+    if (!valid || !nmea_ok)
+       return;
+
+    if (r.rmc) {
+       CHECK(f_time == r.time);
+       CHECK(f_date == r.date);
+       CHECK(f_status == r.status);
+       CHECK(llabs(f_lat - llround(r.lat * 1e7)) <= 1);
+       CHECK(llabs(f_long - llround(r.lon * 1e7)) <= 1);
+       CHECK(abs(f_speed - (int) lround(r.speed * 100)) <= 1);
+       CHECK(abs(f_course - (int) lround(r.course * 100)) <= 1);
+    }
+    else {
+       CHECK(f_fix == (r.fix > 0));
+       CHECK(labs(f_alt - lround(r.alt * 10)) <= 1);
+    }
+}
+
+
+
+int main()
+{
+    int i, k, n_valid = 0;
+    double t0, t_parser, t_ref;
+    ref_t r;
+
+    make_corpus();
+    for (i=0; i<n_corpus; i++) {
+       check_line(corpus[i]);
+       n_valid += nmea_ok;
+    }
+    printf("%d sentences, %d valid RMC/GGA\n", n_corpus, n_valid);
+
+    t0 = host_time();
+    for (k=0; k<BENCH_RUNS; k++)
+       for (i=0; i<n_corpus; i++)
+          feed(corpus[i]);
+    t_parser = host_time() - t0;
+
+    t0 = host_time();
+    for (k=0; k<BENCH_RUNS; k++)
+       for (i=0; i<n_corpus; i++)
+          ref_parse(corpus[i], &r);
+    t_ref = host_time() - t0;
+
+    printf("Parser: %.0f sentences/s, reference (sscanf): %.0f sentences/s\n",
+       n_corpus * BENCH_RUNS / t_parser, n_corpus * BENCH_RUNS / t_ref);
+
+    printf("%s\n", (host_failures == 0 ? "Ok" : "FAILED"));
+    return (host_failures == 0 ? 0 : 1);
+}
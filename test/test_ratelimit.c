@@ -0,0 +1,195 @@
+/*
+ * Digipeater rate limit load test.
+ *
+ * A day of traffic from a few hundred stations is replayed through the
+ * digipeater's rate check: Most stations beacon every few minutes, and
+ * some misconfigured ones every 5 seconds. The flooders must get exactly
+ * their burst and then one frame per period through, and the others
+ * nothing dropped. Then the offered traffic is several times what the
+ * channel can carry, and the transmitter duty cycle must stay at the
+ * ceiling. Also times rlist_allow().
+ */
+
+#include "../ratelimit.c"
+#include "../ax25.c"
+#include "../digipeater.c"
+#include "host.h"
+#include <stdlib.h>
+
+#define N_STATIONS  300
+#define N_FLOODERS  5
+#define DAY         (24 * 3600L * TIMER_RESOLUTION)
+#define STEP        10                       /* Ticks */
+#define BENCH_OPS   10000000
+
+/* Time to send a frame (ticks), and when the transmitter is done */
+static uint32_t tx_ticks = 0, tx_end = 0, ptt = 0;
+
+uint32_t afsk_ptt_ticks()
+   { return ptt; }
+
+/* The heard list is not included */
+bool hlist_exists(uint16_t x) { return false; }
+void hlist_add(uint16_t x) {}
+
+
+static uint16_t next[N_STATIONS], interval[N_STATIONS];
+static long sent[N_STATIONS], dropped[N_STATIONS];
+
+
+
+/*************************************************************************
+ * Frames and transmitter
+ *************************************************************************/
+
+/*
+ * Check frame from station i, and send it if it may be digipeated.
+ * Frames are not heard while transmitting.
+ */
+static void frame_from(int i)
+{
+    char call[16];
+    addr_t from, to, digi;
+    ax25_hdr_t h;
+    FBUF f;
+
+    if (host_ticks < tx_end)
+       return;
+    sprintf(call, "LB%03d-%d", i, i % 16);
+    str2addr(&from, call, false);
+    str2addr(&to, "APRS", false);
+    str2addr(&digi, "WIDE2-2", false);
+    fbuf_new(&f);
+    ax25_encode_header(&f, &from, &to, &digi, 1, FTYPE_UI, PID_NO_L3);
+    fbuf_putstr(&f, "!6000.00N/01030.00E-Test");
+    ax25_hdr_view(&h, &f);
+    if (rate_ok(&h)) {
+       sent[i]++;
+       tx_end = host_ticks + tx_ticks;
+    }
+    else
+       dropped[i]++;
+    fbuf_release(&f);
+}
+
+
+/* Run stations for a time (ticks). Return PTT time */
+static uint32_t run(uint32_t t)
+{
+    uint32_t p = ptt;
+    int i;
+
+    for (; t > 0; t -= STEP) {
+       host_ticks += STEP;
+       if (host_ticks <= tx_end)
+          ptt += STEP;
+       for (i=0; i<N_STATIONS; i++)
+          if (interval[i] > 0 && --next[i] == 0) {
+             next[i] = interval[i] + rand() % 20 - 10;
+             frame_from(i);
+          }
+    }
+    return ptt - p;
+}
+
+
+/* Stations send every interval (ticks), starting at random times */
+static void start(int n, uint16_t i_min, uint16_t i_max)
+{
+    int i;
+
+    memset(next, 0, sizeof(next));
+    memset(interval, 0, sizeof(interval));
+    memset(sent, 0, sizeof(sent));
+    memset(dropped, 0, sizeof(dropped));
+    for (i=0; i<n; i++) {
+       interval[i] = (i_min + rand() % (i_max - i_min + 1)) / STEP;
+       next[i] = 1 + rand() % interval[i];
+    }
+}
+
+
+
+/*************************************************************************
+ * Tests
+ *************************************************************************/
+
+static void check_rate()
+{
+    uint8_t n = 5, w = 10;
+    long allowed = n + DAY / (w * 60L * TIMER_RESOLUTION / n), n_dropped = 0;
+    int i;
+
+    SET_BYTE_PARAM(DIGI_RATE_N, n);
+    SET_BYTE_PARAM(DIGI_RATE_WINDOW, w);
+    SET_BYTE_PARAM(DIGI_MAXDUTY, 0);
+    tx_ticks = 0;
+    start(N_STATIONS, 150 * TIMER_RESOLUTION, 300 * TIMER_RESOLUTION);
+    for (i=0; i<N_FLOODERS; i++)
+       interval[i] = next[i] = 5 * TIMER_RESOLUTION / STEP;
+    run(DAY);
+
+    printf("Flooders: %ld frames each, %ld allowed, sent:", sent[0] + dropped[0], allowed);
+    for (i=0; i<N_FLOODERS; i++) {
+       printf(" %ld", sent[i]);
+       CHECK(labs(sent[i] - allowed) <= 1);
+    }
+    for (i=N_FLOODERS; i<N_STATIONS; i++)
+       n_dropped += dropped[i];
+    printf("\n%d other stations: %ld dropped\n", N_STATIONS - N_FLOODERS, n_dropped);
+    CHECK(n_dropped == 0);
+    CHECK(n_rate > 0 && n_duty == 0);
+}
+
+
+static void check_duty()
+{
+    uint8_t maxduty = 25;
+    uint32_t p, p_max = 0, p_total = 0;
+    int i;
+
+    /* 40 stations every 10 s, one second per frame: Four times the
+     * channel capacity */
+    SET_BYTE_PARAM(DIGI_RATE_N, 0);
+    SET_BYTE_PARAM(DIGI_MAXDUTY, maxduty);
+    tx_ticks = TIMER_RESOLUTION;
+    start(40, 10 * TIMER_RESOLUTION, 10 * TIMER_RESOLUTION);
+    n_duty = 0;
+    for (i=0; i<120; i++) {
+       p = run(2 * DIGI_DUTY_WINDOW);
+       p_total += p;
+       if (p > p_max)
+          p_max = p;
+    }
+    printf("Duty cycle ceiling %u%%: %.1f%% on average, max %.1f%% over %u s\n",
+       maxduty, 100.0 * p_total / (120 * 2 * DIGI_DUTY_WINDOW),
+       100.0 * p_max / (2 * DIGI_DUTY_WINDOW), 2 * DIGI_DUTY_WINDOW / TIMER_RESOLUTION);
+    CHECK(n_duty > 0);
+    CHECK(p_total * 100 <= (maxduty + 1) * 120L * 2 * DIGI_DUTY_WINDOW);
+    CHECK(p_total * 100 >= (maxduty - 3) * 120L * 2 * DIGI_DUTY_WINDOW);
+    CHECK(p_max * 100 <= (maxduty + 3) * 2L * DIGI_DUTY_WINDOW);
+}
+
+
+
+int main()
+{
+    volatile int sink = 0;
+    double t0;
+    long k;
+
+    srand(1);
+    host_ticks = 100000;
+    check_rate();
+    check_duty();
+
+    t0 = host_time();
+    for (k=0; k<BENCH_OPS; k++) {
+       host_ticks += 3;
+       sink += rlist_allow(k * 40503u, 5, 600);
+    }
+    printf("rlist_allow: %.1f ns\n", (host_time() - t0) * 1e9 / BENCH_OPS);
+
+    printf("%s\n", (host_failures == 0 ? "Ok" : "FAILED"));
+    return (host_failures == 0 ? 0 : 1);
+}
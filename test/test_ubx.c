@@ -0,0 +1,199 @@
+/*
+ * UBX replay test.
+ *
+ * The listener thread gets NMEA sentences from a receiver, configures
+ * it for UBX output and then gets NAV-PVT messages with noise and
+ * corrupted messages in between. The position must be the same as from
+ * the corresponding NMEA sentences. Also tests falling back to NMEA
+ * when the receiver does not send NAV-PVT, and the parsing speed.
+ */
+
+#include "../gps.c"
+#include "host.h"
+
+#define BENCH_MSGS  200000
+
+static uint16_t baud = 0;
+
+void uart_set_baud(uint16_t b)
+   { baud = b; }
+
+
+static const char rmc[] =
+    "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n";
+static const char gga[] =
+    "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+
+
+
+/*************************************************************************
+ * UBX messages to and from the receiver
+ *************************************************************************/
+
+static void put32(uint8_t* p, int32_t v)
+{
+    uint8_t i;
+    for (i=0; i<4; i++)
+       p[i] = v >> (8*i);
+}
+
+
+/* NAV-PVT message with the same position as the NMEA sentences */
+static void make_pvt(uint8_t* f, int32_t lat)
+{
+    uint8_t* p = f + 6;
+    uint8_t a = 0, b = 0, i;
+
+    memset(f, 0, 8 + UBX_PVT_LEN);
+    f[0] = UBX_SYNC1; f[1] = UBX_SYNC2;
+    f[2] = UBX_NAV; f[3] = UBX_NAV_PVT; f[4] = UBX_PVT_LEN;
+    p[7] = 23; p[8] = 12; p[9] = 35; p[10] = 19;   /* Day and time */
+    p[20] = 3;                                     /* 3D fix */
+    p[21] = 0x01;                                  /* gnssFixOK */
+    put32(p+24, 115166667);                        /* Longitude */
+    put32(p+28, lat);
+    put32(p+36, 545400);                           /* Height MSL, mm */
+    put32(p+60, 11523);                            /* Ground speed, mm/s */
+    put32(p+64, 8440000);                          /* Heading, 1e-5 deg */
+    for (i=2; i<6 + UBX_PVT_LEN; i++) {
+       a += f[i];
+       b += a;
+    }
+    f[6 + UBX_PVT_LEN] = a;
+    f[7 + UBX_PVT_LEN] = b;
+}
+
+
+static void put_bytes(Stream* s, const uint8_t* data, uint16_t len)
+{
+    while (len-- > 0)
+       stream_put(s, *data++);
+}
+
+
+/*
+ * Get a message sent to the receiver. Return its payload length,
+ * or -1 if there is none or the checksum is wrong.
+ */
+static int get_ubx(Stream* s, uint8_t* cls, uint8_t* id, uint8_t* payload)
+{
+    uint8_t hdr[4], a = 0, b = 0, i, len;
+
+    if (stream_empty(s) || stream_get(s) != UBX_SYNC1 || stream_get(s) != UBX_SYNC2)
+       return -1;
+    for (i=0; i<4; i++) {
+       hdr[i] = stream_get(s);
+       a += hdr[i];
+       b += a;
+    }
+    *cls = hdr[0];
+    *id = hdr[1];
+    len = hdr[2];
+    for (i=0; i<len; i++) {
+       payload[i] = stream_get(s);
+       a += payload[i];
+       b += a;
+    }
+    return (stream_get(s) == a && stream_get(s) == b ? len : -1);
+}
+
+
+/* CFG-PRT message with the given baud rate and output protocol */
+static bool is_cfg_prt(Stream* s, uint16_t baud, uint8_t proto)
+{
+    uint8_t cls, id, p[100];
+    return get_ubx(s, &cls, &id, p) == 20 && cls == UBX_CFG && id == UBX_CFG_PRT
+        && (p[8] | p[9] << 8) == baud && p[14] == proto;
+}
+
+
+
+int main()
+{
+    static Stream gps_in, gps_out;
+    uint8_t pvt[8 + UBX_PVT_LEN], bad[8 + UBX_PVT_LEN], bad_ck[8 + UBX_PVT_LEN];
+    uint8_t p[100], cls, id;
+    uint8_t i;
+    uint32_t k;
+    double t0;
+
+    STREAM_INIT(gps_in, 1024);
+    STREAM_INIT(gps_out, 256);
+    in = &gps_in;
+    gpsout = &gps_out;
+    GET_PARAM(GPS_BAUD, &nmea_baud);
+    SET_BYTE_PARAM(GPS_UBX, 1);
+
+    /* Receiver is configured when it is heard */
+    gps_on();
+    CHECK(ubx_mode == UBX_WAIT);
+    putstr(&gps_in, gga);
+    putstr(&gps_in, rmc);
+    CHECK(!host_run(nmeaListener));
+    CHECK(ubx_mode == UBX_CONF && ubx_timer.count > 0 && baud == 38400);
+    CHECK(get_ubx(&gps_out, &cls, &id, p) == 3 && cls == UBX_CFG && id == UBX_CFG_MSG
+          && p[0] == UBX_NAV && p[1] == UBX_NAV_PVT && p[2] == 1);
+    CHECK(is_cfg_prt(&gps_out, 38400, 0x01));
+    CHECK(stream_empty(&gps_out));
+
+    /* Rest of NMEA sentence, noise, corrupted NAV-PVTs and
+     * enough good ones to get a position. */
+    make_pvt(pvt, 481173000);
+    make_pvt(bad, 0);
+    bad[40] ^= 0x01;
+    make_pvt(bad_ck, 0);
+    bad_ck[sizeof(bad_ck) - 1] ^= 0x01;
+    putstr(&gps_in, "01131.000,E,1,08\r\n");
+    stream_put(&gps_in, UBX_SYNC1);
+    stream_put(&gps_in, 'x');
+    put_bytes(&gps_in, bad, sizeof(bad));
+    for (i=0; i<5; i++)
+       put_bytes(&gps_in, pvt, sizeof(pvt));
+    put_bytes(&gps_in, bad, sizeof(bad));
+    put_bytes(&gps_in, bad_ck, sizeof(bad_ck));
+    CHECK(!host_run(nmeaListener));
+
+    CHECK(ubx_mode == UBX_ON && ubx_timer.count == 0);
+    CHECK(current_pos.latitude == 481173000 && current_pos.longitude == 115166667);
+    CHECK(current_pos.speed == 2240 && current_pos.course == 84);
+    CHECK(current_pos.altitude == 5454);
+    CHECK(current_pos.timestamp == 22 * 86400L + 12 * 3600L + 35 * 60 + 19);
+
+    /* Same position from NMEA */
+    memset(&current_pos, 0, sizeof(current_pos));
+    ubx_mode = UBX_OFF;
+    putstr(&gps_in, gga);
+    putstr(&gps_in, rmc);
+    CHECK(!host_run(nmeaListener));
+    CHECK(current_pos.latitude == 481173000 && current_pos.longitude == 115166667);
+    CHECK(current_pos.speed == 2240 && current_pos.course == 84);
+    CHECK(current_pos.altitude == 5454);
+
+    /* Receiver does not send NAV-PVT. Timer falls back to NMEA output */
+    ubx_mode = UBX_WAIT;
+    putstr(&gps_in, rmc);
+    CHECK(!host_run(nmeaListener));
+    get_ubx(&gps_out, &cls, &id, p);
+    get_ubx(&gps_out, &cls, &id, p);
+    CHECK(ubx_mode == UBX_CONF);
+    ubx_fallback(NULL);
+    CHECK(ubx_mode == UBX_FAIL);
+    CHECK(!host_run(nmeaListener));
+    CHECK(ubx_mode == UBX_OFF && ubx_failed && baud == nmea_baud);
+    CHECK(is_cfg_prt(&gps_out, nmea_baud, 0x02));
+    CHECK(stream_empty(&gps_out));
+
+    /* and UBX mode is not tried again */
+    gps_on();
+    CHECK(ubx_mode == UBX_OFF);
+
+    /* Parsing speed */
+    t0 = host_time();
+    for (k=0; k<BENCH_MSGS; k++)
+       for (i=0; i<sizeof(pvt); i++)
+          ubx_char(pvt[i]);
+    printf("NAV-PVT: %.0f messages/s\n", BENCH_MSGS / (host_time() - t0));
+
+    printf("%s\n", (host_failures == 0 ? "Ok" : "FAILED"));
+    return (host_failures == 0 ? 0 : 1);
+}
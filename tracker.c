@@ -13,6 +13,10 @@
 #include "hdlc.h"
 #include "uart.h"
 #include "ui.h"
+#include "journal.h"
+#include "tracklog.h"
+#include "mice.h"
+#include "chanstat.h"
 
 
 // #include "math.h"
@@ -36,7 +40,10 @@ static void trackerThread(void);
 static void activate_tx(void);
 static bool should_update(posdata_t*, posdata_t*, posdata_t*);
 static bool course_change(uint16_t, uint16_t, uint16_t);
+static uint16_t course_diff(uint16_t, uint16_t);
+static uint8_t predict_update(posdata_t*);
 static void report_status(posdata_t*);
+static void report_telemetry(void);
 static void report_station_position(posdata_t*, bool);
 static void report_object_position(posdata_t*, char*, bool);
 static void report_objects(bool);
@@ -44,19 +51,17 @@ static void report_objects(bool);
 static void send_pos_report(FBUF*, posdata_t*, char, char, bool, bool);
 static void send_extra_report(FBUF* packet, posdata_t* pos, char sym, char symtab);
 static void send_header(FBUF*, bool);
+static void send_header_mice(FBUF*, posdata_t*, bool);
+static void send_latlong(char*, int32_t, bool);
 static void send_timestamp(FBUF* packet, posdata_t* pos);
 static void send_timestamp_z(FBUF* packet, posdata_t* pos);
 static void send_timestamp_compressed(FBUF* packet, posdata_t* pos);
-static void send_latlong_compressed(FBUF*, double, bool);
+static void send_latlong_compressed(FBUF*, int32_t, bool);
 static void send_csT_compressed(FBUF*, posdata_t*);
 
 
 
-double fabs(double); /* INLINE FUNC IN MATH.H - CANNOT BE INCLUDED MORE THAN ONCE */
 int abs(int);  
-double round(double);
-double log(double);
-long lround(double);
 
 extern bool is_off;   /* FIXME: Use accessor function */
 
@@ -70,22 +75,26 @@ void tracker_init()
     bcond_init(&tready, true);
     prev_pos.timestamp=0;
     prev_pos_gps.timestamp=0;
-    if (GET_BYTE_PARAM(TRACKER_ON)) 
+    
+    /* Last known position */
+    journal_get(J_LAST_LAT, &current_pos.latitude);
+    journal_get(J_LAST_LONG, &current_pos.longitude);
+    if (GET_STATE(TRACKER_ON)) 
         THREAD_START(trackerThread, STACK_TRACKER);
 }
 
 
 void tracker_on() 
 {
-    if (GET_BYTE_PARAM(TRACKER_ON))
+    if (GET_STATE(TRACKER_ON))
        return; 
-    SET_BYTE_PARAM(TRACKER_ON, 1);
+    SET_STATE(TRACKER_ON, 1);
     THREAD_START(trackerThread, STACK_TRACKER);
 }
 
 void tracker_off()
 { 
-    SET_BYTE_PARAM(TRACKER_ON, 0);
+    SET_STATE(TRACKER_ON, 0);
 }
 
 
@@ -204,13 +213,15 @@ static void report_objects(bool keep)
  
 static void trackerThread(void)
 {
-    uint8_t t;
+    uint8_t t, skip;
+    uint16_t wait, fixtime;
+    posdata_t dr_pos, *pos;
     uint8_t st_count = GET_BYTE_PARAM(STATUS_TIME);
     
     bcond_wait(&tready); 
     bcond_clear(&tready);
     gps_on();     
-    while (GET_BYTE_PARAM(TRACKER_ON)) 
+    while (GET_STATE(TRACKER_ON)) 
     {
        /*
         * Wait for a fix on position. But with timeout to allow status and 
@@ -232,42 +243,72 @@ static void trackerThread(void)
         if (++st_count >= statustime) {
            st_count = 0;
            report_status(&current_pos);
+           if (GET_BYTE_PARAM(TELEMETRY_ON))
+              report_telemetry();
            report_objects(true);
         }       
         
         /*
-         * Send position report
+         * Send position report. Use the filtered position, speed and course. 
+         * If GPS has lost lock while we are moving, use dead reckoning from 
+         * the last position if good enough. 
          */  
-        if (gps_is_fixed()) {
-           if (should_update(&prev_pos_gps, &prev_pos, &current_pos)) {
+        pos = NULL;
+        if (gps_is_fixed())
+           pos = &filtered_pos;
+        else if (filtered_pos.speed >= KMH2SPEED(3) &&
+                 gps_dead_reckon(&filtered_pos, gps_fix_age(), &dr_pos) <= GET_BYTE_PARAM(TRACKER_MINDIST))
+           pos = &dr_pos;
+           
+        if (pos != NULL) {
+           if (should_update(&prev_pos_gps, &prev_pos, pos)) {
               if (GET_BYTE_PARAM(REPORT_BEEP)) 
                  { beep(3); }
             
-              report_station_position(&current_pos, false);
-              prev_pos = current_pos;                      
+              report_station_position(pos, false);
+              gps_count_report();
+              prev_pos = *pos;                      
+              journal_put(J_LAST_LAT, &pos->latitude);
+              journal_put(J_LAST_LONG, &pos->longitude);
            }
            else {
               if (GET_BYTE_PARAM(FAKE_REPORTS))
-                 report_station_position(&current_pos, true);
+                 report_station_position(pos, true);
            }
         }
-        prev_pos_gps = current_pos;
+        /* Log all positions from GPS, also the ones not reported */
+        if (gps_is_fixed())
+           tracklog_put(&filtered_pos);
+        prev_pos_gps = (pos != NULL ? *pos : filtered_pos);
         activate_tx();
         t = GET_BYTE_PARAM(TRACKER_SLEEP_TIME);
+        wait = t; 
         
-        /* Powersave mode */
+        /* Powersave mode. The GPS can be turned off until the next report
+         * is due: When not moving or no fix, or when dead reckoning predicts
+         * that no report is needed for a while. Turn it on again just in time 
+         * to get a fix, based on the observed time to fix. 
+         */
+        skip = 0;
         if ( maxpause_reached &&
-             ( !gps_is_fixed() || (current_pos.speed < 1 && GET_BYTE_PARAM(GPS_POWERSAVE))))
+             ( !gps_is_fixed() || (filtered_pos.speed < 100 && GET_BYTE_PARAM(GPS_POWERSAVE))))
+             skip = GET_BYTE_PARAM(TRACKER_MAXPAUSE) - 1;
+        else if (gps_is_fixed() && GET_BYTE_PARAM(GPS_POWERSAVE))
+             skip = predict_update(&filtered_pos);
+             
+        if (skip > 0 && (fixtime = gps_fix_time(wait + skip * t)) < wait + skip * t)
         {
-             gps_off();
-             pause_count = GET_BYTE_PARAM(TRACKER_MAXPAUSE) - 1;
-             sleep (pause_count * t * TIMER_RESOLUTION);
+             pause_count = (maxpause_reached ? skip : pause_count + skip);
+             wait += skip * t;
+             gps_standby();
+             sleep ((wait - fixtime) * TIMER_RESOLUTION);
              gps_on();
+             wait = fixtime; 
         }
 
-        t = (t > GPS_FIX_TIME) ?
-            t - GPS_FIX_TIME : 1;
-        sleep(t * TIMER_RESOLUTION); 
+        wait = (wait > GPS_FIX_TIME) ?
+            wait - GPS_FIX_TIME : 1;
+        sleep(wait * TIMER_RESOLUTION); 
         
         uart_rx_resume();
         sleep(GPS_FIX_TIME * TIMER_RESOLUTION);   
@@ -282,7 +323,7 @@ static void trackerThread(void)
  * Activate transmitter - 
  *  If outgoing packets waiting, turn on transmitter, send packets 
  *  and turn off
-/*********************************************************************/
+ *********************************************************************/
 
 static void activate_tx()
 {
@@ -308,14 +349,18 @@ static bool should_update(posdata_t* prev_gps, posdata_t* prev, posdata_t* curre
     GET_PARAM(TRACKER_TURN_LIMIT, &turn_limit);
     uint8_t minpause = GET_BYTE_PARAM(TRACKER_MINPAUSE);
     uint8_t mindist  = GET_BYTE_PARAM(TRACKER_MINDIST);
+    
+    /* Report less often if the channel is congested */
+    if (GET_BYTE_PARAM(CSMA_ADAPTIVE) && chanstat_busy(10) >= CHANNEL_BUSY_LIMIT)
+       minpause = (minpause < 128 ? minpause * 2 : 255);
     uint32_t dist    = (prev->timestamp==0) ? 0 : gps_distance(prev, current);
     uint16_t tdist   = (current->timestamp < prev->timestamp)
                              ? current->timestamp
                              : (current->timestamp - prev->timestamp);
        
-    float est_speed  = (tdist==0) ? 0 : ((float) dist / (float) tdist);
-     /* Note that est_speed is in m/s while
-      * the speed field in  posdata_t is in knots
+    uint32_t est_speed  = (tdist==0) ? 0 : (dist * 100 / tdist);
+     /* Note that est_speed is in cm/s while
+      * the speed field in  posdata_t is in 1/100 knots
       */
         
     maxpause_reached = ( ++pause_count >= GET_BYTE_PARAM(TRACKER_MAXPAUSE)); 
@@ -327,10 +372,10 @@ static bool should_update(posdata_t* prev_gps, posdata_t* prev, posdata_t* curre
      * We may need to calculate the bearing if speed is too low.
      */
     prev_gps_course = course;
-    course = (current->speed > 1 ? current->course 
-                                 : gps_bearing(prev_gps, current));
+    course = (current->speed > 100 ? current->course 
+                                   : gps_bearing(prev_gps, current));
 
-    if ( est_speed > 0.8 && course >= 0 && prev_course >= 0 && 
+    if ( est_speed > 80 && course >= 0 && prev_course >= 0 && 
           course_change(course, prev_course, turn_limit))
     {
         /* If previous gps-pos hasn't been reported already and most of the course change
@@ -338,7 +383,7 @@ static bool should_update(posdata_t* prev_gps, posdata_t* prev, posdata_t* curre
 	 */
         if (GET_BYTE_PARAM(EXTRATURN) != 0 && 
 	        prev_gps->timestamp != prev->timestamp && course >= 0 && prev_gps_course >= 0 &&
-	        course_change(course, prev_gps_course, turn_limit*0.5))
+	        course_change(course, prev_gps_course, turn_limit/2))
 	   putPos(*prev_gps);
 	 
         prev_course = course;
@@ -350,17 +395,17 @@ static bool should_update(posdata_t* prev_gps, posdata_t* prev, posdata_t* curre
                 
         /* Send report when starting or stopping */             
          || ( pause_count >= minpause &&
-             (( current->speed < 3/KNOTS2KMH && prev->speed > 15/KNOTS2KMH ) ||
-              ( prev->speed < 3/KNOTS2KMH && current->speed > 15/KNOTS2KMH )))
+             (( current->speed < KMH2SPEED(3) && prev->speed > KMH2SPEED(15) ) ||
+              ( prev->speed < KMH2SPEED(3) && current->speed > KMH2SPEED(15) )))
 
         /* Distance threshold on low speeds */
-         || ( pause_count >= minpause && est_speed <= 1 && dist >= mindist )
+         || ( pause_count >= minpause && est_speed <= 100 && dist >= mindist )
          
         /* Time period based on average speed */
          || ( est_speed>0 && pause_count >= (uint8_t)
-                            ( (mindist / est_speed)
+                            ( ((uint32_t) mindist * 100 / est_speed)
                               / GET_BYTE_PARAM(TRACKER_SLEEP_TIME)
-                              + minpause*1.4 ))
+                              + minpause*14/10 ))
        )
     {
        pause_count = 0;
@@ -378,6 +423,52 @@ static bool course_change(uint16_t crs, uint16_t prev, uint16_t limit)
 }
 
 
+static uint16_t course_diff(uint16_t crs, uint16_t prev)
+{
+     uint16_t d = (crs > prev ? crs - prev : prev - crs);
+     return (d > 180 ? 360 - d : d);
+}
+
+
+
+/*********************************************************************
+ * Dead reckoning: Predict how many tracker periods can be skipped 
+ * before the next report is due (see should_update), assuming that we 
+ * keep the same speed and turn rate. Stop when the estimated position
+ * becomes too uncertain (radius larger than MINDIST). 
+ *********************************************************************/
+
+static uint8_t predict_update(posdata_t* current)
+{
+    uint16_t turn_limit;
+    GET_PARAM(TRACKER_TURN_LIMIT, &turn_limit);
+    uint8_t t = GET_BYTE_PARAM(TRACKER_SLEEP_TIME);
+    uint8_t mindist = GET_BYTE_PARAM(TRACKER_MINDIST);
+    uint32_t speed = (uint32_t) current->speed * 5144 / 10000;     /* cm/s */
+    uint16_t turned, rate, limit;
+    posdata_t est;
+    uint8_t k;
+    
+    if (speed <= 100 || course >= 360 || prev_course >= 360 || prev_gps_course >= 360)
+       return 0;
+       
+    /* Time period based on speed, or max pause */
+    limit = ((uint32_t) mindist * 100 / speed) / t 
+               + GET_BYTE_PARAM(TRACKER_MINPAUSE)*14/10;
+    limit = min(limit, GET_BYTE_PARAM(TRACKER_MAXPAUSE));
+    
+    /* Turn since last report and during last period */
+    turned = course_diff(course, prev_course);
+    rate = course_diff(course, prev_gps_course);
+    
+    for (k=1; pause_count + k < limit; k++)
+       if ( turned + (k+1) * rate > turn_limit || 
+            gps_dead_reckon(current, (k+1) * t, &est) > mindist )
+          break;
+    return k-1;
+}
+
+
 
 /**********************************************************************
  * APRS status report. 
@@ -414,14 +505,89 @@ static void report_status(posdata_t* pos)
 
 
 
+/**********************************************************************
+ * Telemetry report with transmitter statistics since the last one:
+ * PTT time (sec), transmissions, frames, overhead (percent of bytes
+ * sent) and estimated charge drawn by transmitter (10 mAs units). The
+ * charge is from a fixed current (TX_CURRENT) and does not follow TXPOWER.
+ **********************************************************************/
+
+static void report_telemetry()
+{
+    static uint16_t seq = 0;
+    static txstat_t prev;
+    txstat_t s;
+    uint16_t val[5];
+    uint8_t i;
+    char buf[8];
+    FBUF packet;   
+    
+    hdlc_get_txstat(&s);
+    uint32_t ptt = (s.ptt_ticks - prev.ptt_ticks) / TIMER_RESOLUTION;
+    uint32_t ovh = s.overhead - prev.overhead;
+    uint32_t bytes = s.payload - prev.payload + ovh; 
+    val[0] = ptt;
+    val[1] = s.tx - prev.tx;
+    val[2] = s.frames - prev.frames;
+    val[3] = ovh * 100 / (bytes > 0 ? bytes : 1);
+    val[4] = ptt * TX_CURRENT / 10;
+    prev = s;
+    
+    fbuf_new(&packet);
+    send_header(&packet, false);  
+    sprintf_P(buf, PSTR("T#%03u\0"), seq++ % 1000);
+    fbuf_putstr(&packet, buf);
+    for (i=0; i<5; i++) {
+       sprintf_P(buf, PSTR(",%03u\0"), (val[i] > 255 ? 255 : val[i]));
+       fbuf_putstr(&packet, buf);
+    }
+    fbuf_putstr_P(&packet, PSTR(",00000000"));
+    fbq_put(outframes, packet);
+}
+
+
+
 /**********************************************************************
  * Report position by sending an APRS packet
  *
  **********************************************************************/
 
 #define ASCII_BASE 33
-#define log108(x) (log((x))/0.076961) 
-#define log1002(x) (log((x))/0.001998)
+
+/* Altitude (1/10 m) to feet, rounded */
+#define ALT2FEET(x) ((uint32_t) (((uint64_t) (x) * 32898 + 50000) / 100000))
+
+
+/**********************************************************************
+ * Integer log2 of x with 12 fractional bits
+ **********************************************************************/
+ 
+static uint32_t log2_q12(uint32_t x)
+{
+    uint32_t y, r; 
+    uint8_t n = 0, i;
+    if (x == 0) 
+        return 0;
+    for (y = x; y > 1; y >>= 1)
+        n++;
+    y = (n > 15 ? x >> (n-15) : x << (15-n));   /* 1.15 fixed point */
+    r = (uint32_t) n << 12;
+    for (i=12; i>0; i--) {
+        y = (y * y) >> 15;
+        if (y >= (2UL << 15)) {
+            y >>= 1;
+            r |= 1UL << (i-1);
+        }
+    }
+    return r;
+}
+
+/* log(x)/log(1.002) * 40960, and log(x/100)/log(1.08) */
+#define log1002_q(x)   (log2_q12(x) * 3469UL)
+#define log108_100(x)  (((log2_q12(x) - log2_q12(100)) * 901UL) / 409600)
+
+/* log1002_q of the factor from 1/10 m to feet (FEET2M/10), negated */
+#define LOG1002_Q_FEET2M 22791572UL
 
 extern uint16_t course_count; 
 extern fbq_t *mqueue;
@@ -433,18 +599,26 @@ static void report_station_position(posdata_t* pos, bool no_tx)
     char comment[COMMENT_LENGTH+1];
     fbuf_new(&packet); 
           
-    /* Create packet header */
-    send_header(&packet, no_tx);    
+    if (GET_BYTE_PARAM(MICE_ON)) {
+       /* Mic-E. Latitude is in the destination address field */
+       send_header_mice(&packet, pos, no_tx);
+       mice_info(&packet, pos, GET_BYTE_PARAM(SYMBOL), GET_BYTE_PARAM(SYMBOL_TABLE), 
+          GET_BYTE_PARAM(ALTITUDE_ON));
+    }
+    else {
+       /* Create packet header */
+       send_header(&packet, no_tx);    
     
-    /* APRS Position report body
-     * with Timestamp if the parameter is set 
-     */
-    uint8_t tstamp = GET_BYTE_PARAM(TIMESTAMP_ON); 
-    fbuf_putChar(&packet, (tstamp ? '/' : '!')); 
-    if (tstamp)
-       send_timestamp(&packet, pos);
-    send_pos_report(&packet, pos, GET_BYTE_PARAM(SYMBOL), GET_BYTE_PARAM(SYMBOL_TABLE), 
-       (GET_BYTE_PARAM(COMPRESS_ON) != 0), false );
+       /* APRS Position report body
+        * with Timestamp if the parameter is set 
+        */
+       uint8_t tstamp = GET_BYTE_PARAM(TIMESTAMP_ON); 
+       fbuf_putChar(&packet, (tstamp ? '/' : '!')); 
+       if (tstamp)
+          send_timestamp(&packet, pos);
+       send_pos_report(&packet, pos, GET_BYTE_PARAM(SYMBOL), GET_BYTE_PARAM(SYMBOL_TABLE), 
+          (GET_BYTE_PARAM(COMPRESS_ON) != 0), false );
+    }
        
     /* Add extra reports from buffer 
      * FIXME: Max number of reports - configurable 
@@ -528,30 +702,24 @@ static void send_pos_report(FBUF* packet, posdata_t* pos,
     else
     {
        /* Format latitude and longitude values, etc. */
-       char lat_sn = (pos->latitude < 0 ? 'S' : 'N');
-       char long_we = (pos->longitude < 0 ? 'W' : 'E');
-       float latf = fabs(pos->latitude);
-       float longf = fabs(pos->longitude);
-      
-       sprintf_P(pbuf,  PSTR("%02d%05.2f%c\0"), (int)latf, (latf - (int)latf) * 60, lat_sn);
+       send_latlong(pbuf, pos->latitude, false);
        fbuf_putstr (packet, pbuf);
 
        fbuf_putChar(packet, symtab);
        
-       sprintf_P(pbuf, PSTR("%03d%05.2f%c\0"), (int)longf, (longf - (int)longf) * 60, long_we);
+       send_latlong(pbuf, pos->longitude, true);
        fbuf_putstr (packet, pbuf);
        fbuf_putChar(packet, sym); 
        
        if (simple)
           return;
           
-       sprintf_P(pbuf, PSTR("%03u/%03.0f\0"), pos->course, pos->speed);
+       sprintf_P(pbuf, PSTR("%03u/%03u\0"), pos->course, (pos->speed + 50) / 100);
        fbuf_putstr (packet, pbuf); 
 
        /* Altitude */
        if (pos->altitude >= 0 && GET_BYTE_PARAM(ALTITUDE_ON)) {
-           uint16_t altd = (uint16_t) round(pos->altitude * FEET2M);
-           sprintf_P(pbuf,PSTR("/A=%06u\0"), altd);
+           sprintf_P(pbuf,PSTR("/A=%06lu\0"), ALT2FEET(pos->altitude));
            fbuf_putstr(packet, pbuf);
        }
     }  
@@ -569,16 +737,40 @@ static void send_extra_report(FBUF* packet, posdata_t* pos, char sym, char symta
 
 
 
-static void send_latlong_compressed(FBUF* packet, double pos, bool is_longitude)
+/**********************************************************************
+ * Uncompressed latitude [ddmm.mmN] or longitude [dddmm.mmE]
+ * from 1e-7 degrees
+ **********************************************************************/
+ 
+static void send_latlong(char* buf, int32_t pos, bool is_longitude)
 {
-    uint32_t v = (is_longitude ? 190463 *(180+pos) : 380926 *(90-pos));
-    fbuf_putChar(packet, (char) (lround(v / 753571) + ASCII_BASE));
+    uint32_t a = (pos < 0 ? -pos : pos);
+    uint16_t deg = a / 10000000;
+    uint16_t min = ((a % 10000000) * 6 + 5000) / 10000;   /* 1/100 minutes */
+    if (min >= 6000) {
+       deg++; 
+       min = 0;
+    }
+    if (is_longitude)
+       sprintf_P(buf, PSTR("%03u%02u.%02u%c\0"), deg, min / 100, min % 100, (pos < 0 ? 'W' : 'E'));
+    else
+       sprintf_P(buf, PSTR("%02u%02u.%02u%c\0"), deg, min / 100, min % 100, (pos < 0 ? 'S' : 'N'));
+}
+
+
+
+static void send_latlong_compressed(FBUF* packet, int32_t pos, bool is_longitude)
+{
+    uint32_t v = (is_longitude 
+         ? (uint32_t) (((uint64_t) (1800000000L + pos) * 190463) / 10000000)
+         : (uint32_t) (((uint64_t) (900000000L - pos) * 380926) / 10000000));
+    fbuf_putChar(packet, (char) (v / 753571 + ASCII_BASE));
     v %= 753571;
-    fbuf_putChar(packet, (char) (lround(v / 8281) + ASCII_BASE));
+    fbuf_putChar(packet, (char) (v / 8281 + ASCII_BASE));
     v %= 8281;
-    fbuf_putChar(packet, (char) (lround(v / 91) + ASCII_BASE));
+    fbuf_putChar(packet, (char) (v / 91 + ASCII_BASE));
     v %= 91;
-    fbuf_putChar(packet, (char) (lround(v) + ASCII_BASE));   
+    fbuf_putChar(packet, (char) (v + ASCII_BASE));   
 }
 
 
@@ -587,17 +779,18 @@ static void send_csT_compressed(FBUF* packet, posdata_t* pos)
 /* FIXME: Special case where there is no course/speed ? */
 {
     if (pos->altitude >= 0 && GET_BYTE_PARAM(ALTITUDE_ON)) {
-       /* Send altitude */
-       uint32_t alt =  (uint32_t) log1002((double)pos->altitude * FEET2M);
-       fbuf_putChar(packet, (char) (lround(alt / 91) + ASCII_BASE));
+       /* Send altitude in feet, log scale. Below one foot, send zero */
+       uint32_t alt =  log1002_q(pos->altitude);
+       alt = (alt < LOG1002_Q_FEET2M ? 0 : (alt - LOG1002_Q_FEET2M) / 40960);
+       fbuf_putChar(packet, (char) (alt / 91 + ASCII_BASE));
        alt %= 91;
-       fbuf_putChar(packet, (char) (lround(alt) + ASCII_BASE));
+       fbuf_putChar(packet, (char) (alt + ASCII_BASE));
        fbuf_putChar(packet, 0x10 + ASCII_BASE);
     }
     else {
        /* Send course/speed (default) */
        fbuf_putChar(packet, pos->course / 4 + ASCII_BASE);
-       fbuf_putChar(packet, (char) log108((double) pos->speed+1) + ASCII_BASE); 
+       fbuf_putChar(packet, (char) log108_100(pos->speed + 100) + ASCII_BASE); 
        fbuf_putChar(packet, 0x18 + ASCII_BASE);
     }
 }
@@ -607,18 +800,36 @@ static void send_csT_compressed(FBUF* packet, posdata_t* pos)
 
 static void send_header(FBUF* packet, bool no_tx)
 {
-    addr_t from, to; 
-    GET_PARAM(MYCALL, &from);   
-    GET_PARAM(DEST, &to);
-    addr_t digis[7];
-    uint8_t ndigis = 0;
     if (no_tx) {
-       ndigis = 1;
-       str2addr(&digis[0], "NO_TX", false);
+       addr_t from, to, digi; 
+       GET_PARAM(MYCALL, &from);   
+       GET_PARAM(DEST, &to);
+       str2addr(&digi, "NO_TX", false);
+       ax25_encode_header(packet, &from, &to, &digi, 1, FTYPE_UI, PID_NO_L3);
     }
+    else
+       ax25_own_header(packet);
+}
+
+
+
+/**********************************************************************
+ * Header for Mic-E reports. The destination callsign encodes the
+ * latitude, so the cached own header cannot be used.
+ **********************************************************************/
+
+static void send_header_mice(FBUF* packet, posdata_t* pos, bool no_tx)
+{
+    addr_t from, to, digis[7];
+    uint8_t ndigis = 1;
+    GET_PARAM(MYCALL, &from);
+    GET_PARAM(DEST, &to);
+    mice_dest(&to, pos, MICE_EN_ROUTE);
+    if (no_tx)
+       str2addr(&digis[0], "NO_TX", false);
     else {
+       GET_PARAM(DIGIS, &digis);
        ndigis = GET_BYTE_PARAM(NDIGIS);
-       GET_PARAM(DIGIS, &digis);      
     }
     ax25_encode_header(packet, &from, &to, digis, ndigis, FTYPE_UI, PID_NO_L3);
 }
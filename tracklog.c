@@ -0,0 +1,287 @@
+/*
+ * Track log. Positions computed by the tracker are stored in a ring
+ * buffer in EEPROM, so that the full track can be downloaded after a
+ * mission, also positions that were not transmitted.
+ *
+ * The log region is divided into blocks. Each block starts with a key
+ * record (sequence number, time and absolute position). It is followed
+ * by records with time and position deltas from the previous record,
+ * in 3, 5 or 6 bytes. Positions are stored in units of 1e-5 degrees.
+ * The end of the log is marked with TL_END. When the last block is
+ * full, the oldest block is reused. Only bytes that are changed are
+ * written, and the writer yields while the EEPROM is busy.
+ *
+ * Macros for configuration (defined in defines.h)
+ *    TRACKLOG_START  - EEPROM address of track log region.
+ *    TRACKLOG_BLOCKS - number of blocks (less than 128).
+ *    TRACKLOG_BSIZE  - size of each block (bytes).
+ */
+
+#include "defines.h"
+#include "kernel/kernel.h"
+#include "config.h"
+#include "tracklog.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Record types. Other values of the first byte are delta records:
+ *   00tttttt dlat dlon           - 8 bit deltas, time delta < 64 sec
+ *   01tttttt dlat(2) dlon(2)     - 16 bit deltas, time delta < 64 sec
+ *   10000000 t dlat(2) dlon(2)   - 16 bit deltas, time delta < 256 sec
+ */
+#define TL_DELTA16  0x40
+#define TL_DELTA16T 0x80
+#define TL_KEY      0xC0     /* seq, time(4), lat(4), long(4). Start of block */
+#define TL_ABS      0xC1     /* time(4), lat(4), long(4) */
+#define TL_PAD      0xFE     /* Rest of block is unused */
+#define TL_END      0xFF     /* End of log */
+
+/* Don't log if moved less than this (1e-5 degrees), unless time delta is large */
+#define TL_MINMOVE  3
+#define TL_MAXTIME  240
+
+#define TL_ADDR(b, off) ((uint8_t*) (TRACKLOG_START + (uint16_t) (b) * TRACKLOG_BSIZE + (off)))
+#define DEG5(x)         ((x) >= 0 ? ((x) + 50) / 100 : ((x) - 50) / 100)
+
+
+typedef struct {
+    uint32_t time;
+    int32_t lat, lon;
+} tlpos_t;
+
+static uint8_t blk, seq;      /* Current block and its sequence number */
+static uint16_t wpos = 0;     /* Write position in block. 0 if log is empty */
+static tlpos_t last;          /* Last logged position */
+static Mutex tlock;
+
+static uint8_t read_rec(uint8_t, uint16_t, tlpos_t*);
+
+
+
+static uint8_t ee_get(const uint8_t* addr)
+{
+    while (!eeprom_is_ready())
+       t_yield();
+    return eeprom_read_byte(addr);
+}
+
+
+static void ee_put(uint8_t* addr, uint8_t x)
+{
+    while (!eeprom_is_ready())
+       t_yield();
+    if (eeprom_read_byte(addr) != x)
+       eeprom_write_byte(addr, x);
+}
+
+
+static int32_t ee_get32(const uint8_t* addr)
+{
+    uint32_t x = 0;
+    for (int8_t i=3; i>=0; i--)
+       x = (x << 8) | ee_get(addr+i);
+    return (int32_t) x;
+}
+
+
+static uint8_t* put32(uint8_t* p, uint32_t x)
+{
+    for (uint8_t i=0; i<4; i++, x >>= 8)
+       *p++ = x & 0xff;
+    return p;
+}
+
+
+
+/* True if block b is the successor of the block with sequence number s */
+static bool is_next(uint8_t b, uint8_t s)
+   { return ee_get(TL_ADDR(b, 0)) == TL_KEY && ee_get(TL_ADDR(b, 1)) == (uint8_t) (s+1); }
+
+
+
+/*************************************************************************
+ * Find the current (latest) block and the end of the log.
+ *************************************************************************/
+
+void tracklog_init()
+{
+    uint8_t b, len;
+    mutex_init(&tlock);
+    wpos = 0;
+
+    /* The latest block is the one not followed by its successor */
+    for (b=0; b<TRACKLOG_BLOCKS; b++)
+       if (ee_get(TL_ADDR(b, 0)) == TL_KEY &&
+             !is_next((b+1) % TRACKLOG_BLOCKS, ee_get(TL_ADDR(b, 1)))) {
+          blk = b;
+          seq = ee_get(TL_ADDR(b, 1));
+          break;
+       }
+    if (b == TRACKLOG_BLOCKS)
+       return;
+
+    /* Find end of block and last position */
+    for (wpos = 0; (len = read_rec(blk, wpos, &last)) > 0; wpos += len)
+       ;
+    if (wpos >= TRACKLOG_BSIZE || ee_get(TL_ADDR(blk, wpos)) != TL_END)
+       wpos = TRACKLOG_BSIZE;
+}
+
+
+
+/*************************************************************************
+ * Read record at position off in block b, and update p. Return length
+ * of record, or 0 if at end of block or log.
+ *************************************************************************/
+
+static uint8_t read_rec(uint8_t b, uint16_t off, tlpos_t* p)
+{
+    if (off >= TRACKLOG_BSIZE)
+       return 0;
+    uint8_t* a = TL_ADDR(b, off);
+    uint8_t t = ee_get(a);
+
+    if (t == TL_KEY || t == TL_ABS) {
+       if (t == TL_KEY)
+          a++;
+       p->time = ee_get32(a+1);
+       p->lat = ee_get32(a+5);
+       p->lon = ee_get32(a+9);
+       return (t == TL_KEY ? 14 : 13);
+    }
+    if (t < TL_DELTA16) {
+       p->time += t;
+       p->lat += (int8_t) ee_get(a+1);
+       p->lon += (int8_t) ee_get(a+2);
+       return 3;
+    }
+    if (t <= TL_DELTA16T) {
+       if (t == TL_DELTA16T)
+          p->time += ee_get(++a);
+       else
+          p->time += t & 0x3f;
+       p->lat += (int16_t) (ee_get(a+1) | (ee_get(a+2) << 8));
+       p->lon += (int16_t) (ee_get(a+3) | (ee_get(a+4) << 8));
+       return (t == TL_DELTA16T ? 6 : 5);
+    }
+    return 0;
+}
+
+
+
+/*************************************************************************
+ * Append position to log.
+ *************************************************************************/
+
+void tracklog_put(posdata_t* pos)
+{
+    uint8_t rec[14], *p = rec, i;
+    tlpos_t x = { pos->timestamp, DEG5(pos->latitude), DEG5(pos->longitude) };
+    int32_t dlat = x.lat - last.lat, dlon = x.lon - last.lon;
+    uint32_t dt = x.time - last.time;
+
+    if (!GET_BYTE_PARAM(TRACKLOG_ON))
+       return;
+    mutex_lock(&tlock);
+
+    if (wpos > 0 && x.time >= last.time && dt < 256) {
+       if (labs(dlat) < TL_MINMOVE && labs(dlon) < TL_MINMOVE && dt < TL_MAXTIME) {
+          mutex_unlock(&tlock);
+          return;
+       }
+       if (dt < 64 && dlat >= -128 && dlat < 128 && dlon >= -128 && dlon < 128) {
+          *p++ = dt;
+          *p++ = dlat;
+          *p++ = dlon;
+       }
+       else if (labs(dlat) < 32768 && labs(dlon) < 32768) {
+          if (dt < 64)
+             *p++ = TL_DELTA16 | dt;
+          else {
+             *p++ = TL_DELTA16T;
+             *p++ = dt;
+          }
+          *p++ = dlat & 0xff;  *p++ = dlat >> 8;
+          *p++ = dlon & 0xff;  *p++ = dlon >> 8;
+       }
+    }
+    /* Absolute position if a delta record is not possible */
+    if (p == rec) {
+       *p++ = TL_ABS;
+       p = put32(p, x.time);
+       p = put32(p, x.lat);
+       p = put32(p, x.lon);
+    }
+
+    /* Start new block with a key record if log is empty or if there
+     * is no room for the record and an end marker
+     */
+    if (wpos == 0 || wpos + (p-rec) >= TRACKLOG_BSIZE) {
+       if (wpos == 0)
+          blk = seq = 0;
+       else {
+          if (wpos < TRACKLOG_BSIZE)
+             ee_put(TL_ADDR(blk, wpos), TL_PAD);
+          blk = (blk + 1) % TRACKLOG_BLOCKS;
+          seq++;
+       }
+       wpos = 0;
+       p = rec;
+       *p++ = TL_KEY;
+       *p++ = seq;
+       p = put32(p, x.time);
+       p = put32(p, x.lat);
+       p = put32(p, x.lon);
+    }
+
+    for (i=0; i < p-rec; i++)
+       ee_put(TL_ADDR(blk, wpos+i), rec[i]);
+    wpos += p-rec;
+    ee_put(TL_ADDR(blk, wpos), TL_END);
+    last = x;
+    mutex_unlock(&tlock);
+}
+
+
+
+/*************************************************************************
+ * Write the log as CSV lines: day of month, time (UTC), latitude,
+ * longitude, starting with the oldest position.
+ *************************************************************************/
+
+void tracklog_dump(Stream* out)
+{
+    uint8_t b, i, len;
+    uint16_t off;
+    tlpos_t p;
+    char buf[48], latbuf[14], longbuf[14];
+
+    mutex_lock(&tlock);
+    putstr_P(out, PSTR("day,time,lat,long\r\n"));
+    if (wpos > 0)
+       /* Oldest block is the first one in sequence before the current */
+       for (i=1; i<=TRACKLOG_BLOCKS; i++) {
+          b = (blk + i) % TRACKLOG_BLOCKS;
+          if (ee_get(TL_ADDR(b, 0)) != TL_KEY ||
+                ee_get(TL_ADDR(b, 1)) != (uint8_t) (seq - TRACKLOG_BLOCKS + i))
+             continue;
+          for (off = 0; (len = read_rec(b, off, &p)) > 0; off += len) {
+             sprintf_P(buf, PSTR("%lu,%02u:%02u:%02u,%s,%s\r\n"), p.time / 86400 + 1,
+                (uint8_t) ((p.time / 3600) % 24), (uint8_t) ((p.time / 60) % 60), (uint8_t) (p.time % 60),
+                deg2str(latbuf, p.lat * 100), deg2str(longbuf, p.lon * 100));
+             putstr(out, buf);
+          }
+       }
+    mutex_unlock(&tlock);
+}
+
+
+
+void tracklog_clear()
+{
+    mutex_lock(&tlock);
+    for (uint8_t b=0; b<TRACKLOG_BLOCKS; b++)
+       ee_put(TL_ADDR(b, 0), TL_END);
+    wpos = 0;
+    mutex_unlock(&tlock);
+}
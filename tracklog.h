@@ -0,0 +1,12 @@
+#if !defined __TRACKLOG_H__
+#define __TRACKLOG_H__
+
+#include "kernel/stream.h"
+#include "gps.h"
+
+void tracklog_init(void);
+void tracklog_put(posdata_t*);
+void tracklog_dump(Stream*);
+void tracklog_clear(void);
+
+#endif /* __TRACKLOG_H__ */
@@ -4,6 +4,7 @@
 
 Stream* uart_tx_init(uint16_t baud);
 Stream* uart_rx_init(uint16_t baud, bool e);
+void uart_set_baud(uint16_t baud);
 void uart_rx_pause();
 void uart_rx_resume();
 
@@ -10,6 +10,7 @@
 #include "kernel/timer.h"
 #include <stdlib.h>
 #include "config.h"
+#include "journal.h"
 #include "ui.h"
 #include <avr/sleep.h>
 #include <avr/wdt.h>
@@ -496,7 +497,7 @@ static void ui_thread(void)
         rgb_led_on(false,false,true);
     
     /* Activate digipeater if requested */
-    if (GET_BYTE_PARAM(DIGIPEATER_ON)) {
+    if (GET_STATE(DIGIPEATER_ON)) {
       sleep (100);
       digipeater_activate(true);
     }
@@ -5,11 +5,13 @@
 #include "ui.h"
 #include <avr/sleep.h>
 
-#define CDC_BUF_SIZE 64
+#define CDC_BUF_SIZE 128
 
 Semaphore cdc_run;    
 Stream cdc_instr; 
 Stream cdc_outstr;
+Stream cdc_data_instr; 
+Stream cdc_data_outstr;
 BCond usb_active;
 
 
@@ -26,11 +28,11 @@ USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface =
 
          .DataINEndpointNumber           = CDC_TX_EPNUM,
          .DataINEndpointSize             = CDC_TXRX_EPSIZE,
-         .DataINEndpointDoubleBank       = false,
+         .DataINEndpointDoubleBank       = true,
 
          .DataOUTEndpointNumber          = CDC_RX_EPNUM,
          .DataOUTEndpointSize            = CDC_TXRX_EPSIZE,
-         .DataOUTEndpointDoubleBank      = false,
+         .DataOUTEndpointDoubleBank      = true,
 
          .NotificationEndpointNumber     = CDC_NOTIFICATION_EPNUM,
          .NotificationEndpointSize       = CDC_NOTIFICATION_EPSIZE,
@@ -39,6 +41,79 @@ USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface =
 };
 
 
+/* Second CDC interface. Binary data channel for machine traffic (KISS etc.) */
+
+USB_ClassInfo_CDC_Device_t Data_CDC_Interface =
+{
+    .Config = 
+    {
+         .ControlInterfaceNumber         = 2,
+
+         .DataINEndpointNumber           = CDC2_TX_EPNUM,
+         .DataINEndpointSize             = CDC_TXRX_EPSIZE,
+         .DataINEndpointDoubleBank       = true,
+
+         .DataOUTEndpointNumber          = CDC2_RX_EPNUM,
+         .DataOUTEndpointSize            = CDC_TXRX_EPSIZE,
+         .DataOUTEndpointDoubleBank      = true,
+
+         .NotificationEndpointNumber     = CDC2_NOTIFICATION_EPNUM,
+         .NotificationEndpointSize       = CDC_NOTIFICATION_EPSIZE,
+         .NotificationEndpointDoubleBank = false,
+    },
+};
+
+
+
+/* Packet buffer, one endpoint bank in size */
+static uint8_t cdc_pkt[CDC_TXRX_EPSIZE];
+
+
+
+/***************************************************************************
+ * Move data received on the OUT endpoint into the input stream. Read as 
+ * much as there is room for in the stream in one block. The endpoint 
+ * bank is released when it has been emptied.
+ ***************************************************************************/
+
+static void cdc_receive(USB_ClassInfo_CDC_Device_t* cdc, Stream* in)
+{
+    uint16_t n = CDC_Device_BytesReceived(cdc);
+    if (n == 0)
+       return;
+    if (n > in->capacity.cnt)
+       n = in->capacity.cnt;
+    if (n > CDC_TXRX_EPSIZE)
+       n = CDC_TXRX_EPSIZE;
+    if (n == 0)
+       return;
+       
+    Endpoint_Read_Stream_LE(cdc_pkt, n, NO_STREAM_CALLBACK);
+    if (!Endpoint_BytesInEndpoint())
+       Endpoint_ClearOUT();
+    for (uint8_t i=0; i<n; i++)
+       stream_put(in, cdc_pkt[i]);
+}
+
+
+
+/***************************************************************************
+ * Drain output stream in chunks of (at most) one endpoint bank and
+ * write them to the IN endpoint as a block. 
+ ***************************************************************************/
+
+static void cdc_send(USB_ClassInfo_CDC_Device_t* cdc, Stream* out)
+{
+    while (!stream_empty(out))
+    {
+       uint8_t n = 0; 
+       while (n < CDC_TXRX_EPSIZE && !stream_empty(out))
+          cdc_pkt[n++] = stream_get(out);
+       CDC_Device_SendString(cdc, (char*) cdc_pkt, n);
+    }
+}
+
+
 
 /* Main thread */
 void usb_thread (void)
@@ -47,15 +122,15 @@ void usb_thread (void)
     {
          bcond_wait(&usb_active);
          t_yield();
-         int16_t c; 
-         while ((c = CDC_Device_ReceiveByte(&VirtualSerial_CDC_Interface)) > 0)
-            stream_put(&cdc_instr, c);
+         cdc_receive(&VirtualSerial_CDC_Interface, &cdc_instr);
+         cdc_receive(&Data_CDC_Interface, &cdc_data_instr);
  
          t_yield();
-         while ( ! stream_empty(&cdc_outstr))
-            CDC_Device_SendByte(&VirtualSerial_CDC_Interface, stream_get(&cdc_outstr)); 
+         cdc_send(&VirtualSerial_CDC_Interface, &cdc_outstr);
+         cdc_send(&Data_CDC_Interface, &cdc_data_outstr);
                        
          CDC_Device_USBTask(&VirtualSerial_CDC_Interface);
+         CDC_Device_USBTask(&Data_CDC_Interface);
 	 USB_USBTask();	
     }
 }
@@ -80,7 +155,8 @@ void EVENT_USB_Device_Disconnect(void)
 /* Event handler for the library USB Configuration Changed event. */
 void EVENT_USB_Device_ConfigurationChanged(void)
 {
-	if ((CDC_Device_ConfigureEndpoints(&VirtualSerial_CDC_Interface)))
+	if (CDC_Device_ConfigureEndpoints(&VirtualSerial_CDC_Interface) &&
+	    CDC_Device_ConfigureEndpoints(&Data_CDC_Interface))
 	{
              led_usb_on(); 
              sem_up(&cdc_run);    
@@ -92,6 +168,7 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 void  EVENT_USB_Device_ControlRequest(void)
 {
     CDC_Device_ProcessControlRequest(&VirtualSerial_CDC_Interface);
+    CDC_Device_ProcessControlRequest(&Data_CDC_Interface);
 }
 
 
@@ -112,6 +189,9 @@ void usb_init()
    STREAM_INIT( cdc_instr, CDC_BUF_SIZE);
    STREAM_INIT( cdc_outstr, CDC_BUF_SIZE);
    cdc_outstr.kick = NULL;
+   STREAM_INIT( cdc_data_instr, CDC_BUF_SIZE);
+   STREAM_INIT( cdc_data_outstr, CDC_BUF_SIZE);
+   cdc_data_outstr.kick = NULL;
    
    THREAD_START(usb_thread, STACK_USB);
 }
@@ -43,20 +43,33 @@
 		#include <LUFA/Drivers/USB/Class/CDC.h>
 
 	/* Macros: */
+		/* LUFA allocates endpoint memory in the order endpoints are configured, and
+		 * they must be configured in ascending order. The console interface is
+		 * configured first, so its endpoints must have the lowest numbers. */
+
 		/** Endpoint number of the CDC device-to-host notification IN endpoint. */
-		#define CDC_NOTIFICATION_EPNUM         2
+		#define CDC_NOTIFICATION_EPNUM         1
 
 		/** Endpoint number of the CDC device-to-host data IN endpoint. */
-		#define CDC_TX_EPNUM                   3	
+		#define CDC_TX_EPNUM                   2	
 
 		/** Endpoint number of the CDC host-to-device data OUT endpoint. */
-		#define CDC_RX_EPNUM                   4	
+		#define CDC_RX_EPNUM                   3	
+
+		/** Endpoint number of the second (data channel) CDC interface's notification IN endpoint. */
+		#define CDC2_NOTIFICATION_EPNUM        4
+
+		/** Endpoint number of the second (data channel) CDC interface's data IN endpoint. */
+		#define CDC2_TX_EPNUM                  5	
+
+		/** Endpoint number of the second (data channel) CDC interface's data OUT endpoint. */
+		#define CDC2_RX_EPNUM                  6	
 
 		/** Size in bytes of the CDC device-to-host notification IN endpoint. */
 		#define CDC_NOTIFICATION_EPSIZE        8
 
 		/** Size in bytes of the CDC data IN and OUT endpoints. */
-		#define CDC_TXRX_EPSIZE                16	
+		#define CDC_TXRX_EPSIZE                64	
 
 	/* Type Defines: */
 		/** Type define for the device configuration descriptor structure. This must be defined in the
@@ -66,6 +79,7 @@
 		typedef struct
 		{
 			USB_Descriptor_Configuration_Header_t    Config;
+			USB_Descriptor_Interface_Association_t   IAD;
 			USB_Descriptor_Interface_t               CCI_Interface;
 			CDC_FUNCTIONAL_DESCRIPTOR(2)             CDC_Functional_IntHeader;
 			CDC_FUNCTIONAL_DESCRIPTOR(2)             CDC_Functional_CallManagement;
@@ -75,6 +89,16 @@
 			USB_Descriptor_Interface_t               DCI_Interface;
 			USB_Descriptor_Endpoint_t                DataOutEndpoint;
 			USB_Descriptor_Endpoint_t                DataInEndpoint;
+			USB_Descriptor_Interface_Association_t   CDC2_IAD;
+			USB_Descriptor_Interface_t               CDC2_CCI_Interface;
+			CDC_FUNCTIONAL_DESCRIPTOR(2)             CDC2_Functional_IntHeader;
+			CDC_FUNCTIONAL_DESCRIPTOR(2)             CDC2_Functional_CallManagement;
+			CDC_FUNCTIONAL_DESCRIPTOR(1)             CDC2_Functional_AbstractControlManagement;
+			CDC_FUNCTIONAL_DESCRIPTOR(2)             CDC2_Functional_Union;
+			USB_Descriptor_Endpoint_t                CDC2_ManagementEndpoint;
+			USB_Descriptor_Interface_t               CDC2_DCI_Interface;
+			USB_Descriptor_Endpoint_t                CDC2_DataOutEndpoint;
+			USB_Descriptor_Endpoint_t                CDC2_DataInEndpoint;
 		} USB_Descriptor_Configuration_t;
 
 	/* Function Prototypes: */